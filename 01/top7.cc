@@ -1,65 +1,47 @@
 #include <iostream>
+#include <fstream>
+#include <string_view>
 #include <regex>
-#include <unordered_set>
+#include <sstream>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <charconv>
+#include <concepts>
+#include <vector>
+#include <array>
+#include <thread>
+#include <chrono>
+#include <csignal>
 #include <unordered_map>
+#include <map>
 #include <algorithm>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "top7.h"
+
 /// Wejście, wyjście
-using std::string, std::to_string;
-using std::getline;
-using std::cout, std::cin, std::cerr, std::endl;
+using std::string, std::string_view;
+using std::ostream, std::ifstream, std::ofstream;
 
 /// Struktury danych.
-using std::vector, std::unordered_map, std::unordered_set, std::pair,
-      std::tuple;
+using std::vector, std::array, std::unordered_map, std::pair;
 
 /// Narzędzia
-using std::sort, std::min, std::stoi,
-      std::make_tuple, std::istringstream;
-
-/// Linie odczytu i jej numeracja.
-using line_t = string;
-using line_num_t = size_t;
-
-/// Zbiór utworów, które wypadły z głosowania.
-using track_id_t = int_least32_t;
-using dropped_tracks_t = unordered_set<track_id_t>;
+using std::sort, std::min;
 
-/// Wektor zbiorów głosów zebranych w pojedynczej liniach.
-using vote_set_t = unordered_set<track_id_t>;
+/// Silnik list przebojów.
+using top7::track_id_t, top7::track_ids_t, top7::track_span_t,
+      top7::count_t, top7::count_per_track_t, top7::track_rank_t,
+      top7::ranking_t, top7::DEFAULT_TOP_COUNT;
 
-/** Notowanie (podsumowanie) utworów.
- * $1 - numer utworu;
- * $2 - ilość głosów (punktów) zdobyta przez ten utwór.
- */
-using count_t = size_t;
-using count_per_track_t = unordered_map<track_id_t, count_t>;
-
-/** Rozkład miejsc w poprzednim notowaniu (podsumowaniu) utworów.
- * $1 - numer utworu;
- * $2 - pozycja w poprzednim new7 (top7).
- */
-using track_rank_t = int_least32_t;
-using unordered_ranks_t = unordered_map<track_id_t, track_rank_t>;
-
-/// Posortowane przeboje. Rozmiar niekoniecznie musi być 7. Wartością są punkty.
-using top7_pair = pair<track_id_t, count_t>;
-using top7_t = vector<top7_pair>;
-
-/// Posortowane utwory. Rozmiar niekoniecznie musi być 7. Wartością są
-/// pozycje w rankingu.
-using sorted_rank_pair = pair<track_id_t, track_rank_t>;
-using ordered_ranks_t = vector<sorted_rank_pair>;
-
-  /** Przechowywane struktury danych.
-   * $0 - zebrane punkty przez poszczególne utwory;
-   * $1 - rozkład miejsc w poprzednim podsumowaniu;
-   * $2 - zbiór utworów, które wypadły z losowania;
-   * $3 - rozkład miejsc w poprzednim notowaniu;
-   * $4 - wektor zbiorów głosów zebranych w pojedynczych liniach.
-   */
-using hit_list_t = tuple<count_per_track_t, unordered_ranks_t,
-  dropped_tracks_t, unordered_ranks_t, count_per_track_t>;
+/// Linie odczytu i jej numeracja. Linia jest widokiem na bufor wejścia.
+using line_t = string_view;
+using line_num_t = size_t;
 
 namespace {
 
@@ -68,74 +50,74 @@ namespace {
     Vote, New, Top, Empty
   };
 
-  /// Klucz w strukturze danych poprzedniego notowania do bieżącego MAX.
-  int const MAX_VOTE_ID = 100000000;
-
-  /// Liczba przebojów pojedynczego notowania (podsumowania).
-  unsigned const TOP_COUNT = 7;
-
-  /** Przechowywane struktury danych.
-   * $0 - zebrane punkty przez poszczególne utwory;
-   * $1 - rozkład miejsc w poprzednim podsumowaniu;
-   * $2 - zbiór utworów, które wypadły z losowania;
-   * $3 - rozkład miejsc w poprzednim notowaniu;
-   * $4 - wektor zbiorów głosów zebranych w pojedynczych liniach.
-   */
-  int const POINTS = 0;
-  int const PREVIOUS_OVERALL = 1;
-  int const DROPPED = 2;
-  int const PREVIOUS_LISTING = 3;
-  int const POLL = 4;
-
   /// Funkcje przeznaczone do parsowania.
   namespace IO {
 
-    using std::regex;
-
     string const DELIM(" ");
-    string const NEW("NEW");
-    string const TOP("TOP");
-    int const NUM_LEN = 8;
-
-    string const whitespace_str(" \t\f\v\n\r");
-    regex const whitespace_expr("[[:space:]]+");
-    regex const num_prefix0_expr(DELIM + "0");
-    regex const num_len_expr("[0-9]{" + to_string(NUM_LEN + 1) + "}");
-    regex const only_digits_expr("[0-9]+");
-    regex const digits_spaces_expr("[0-9[:space:]]+");
-
-    /** Obcina z linii białe znaki na początku i na końcu, a wszystkie w
-     * środku zamienia na napis DELIM.
+    string const RANK_NO_CHANGE("-");
+    string_view const NEW("NEW");
+    string_view const TOP("TOP");
+    char const CHART_MARK = '@';
+    char const TOP_COUNT_MARK = ':';
+    size_t const NUM_LEN = 8;
+
+    string_view const whitespace_str(" \t\f\v\n\r");
+
+    /** Sprawdza, czy znak jest białym znakiem.
+     * @param[in] c - sprawdzany znak.
+     * @return True, jeżeli c należy do whitespace_str, false w przeciwnym
+     * razie.
+     */
+    bool is_space(char const c) {
+      return whitespace_str.find(c) != string_view::npos;
+    }
+
+    /** Sprawdza, czy znak jest cyfrą dziesiętną.
+     * @param[in] c - sprawdzany znak.
+     * @return True, jeżeli c jest cyfrą, false w przeciwnym razie.
+     */
+    bool is_digit(char const c) {
+      return '0' <= c && c <= '9';
+    }
+
+    /** Obcina z linii białe znaki na początku i na końcu.
      * @param[in, out] line - linia wejścia do przycięcia.
      */
-    void trim_spaces(line_t &line) {
-      line.erase(line.find_last_not_of(whitespace_str) + 1);
-      line.erase(0, line.find_first_not_of(whitespace_str));
-      line = regex_replace(line, whitespace_expr, DELIM);
+    void trim_spaces(string_view &line) {
+      while (!line.empty() && is_space(line.back()))
+        line.remove_suffix(1);
+      while (!line.empty() && is_space(line.front()))
+        line.remove_prefix(1);
     }
 
     /** Funkcja pomocnicza dla parse_command().
-     * @param[in, out] line - pojedyncza linia wejścia. Jeżeli polecenie
-     * zostało rozpoznane, napis jest o to polecenie obcięty;
+     * Za poleceniem pomijany jest jeden separator: cały ciąg białych znaków
+     * albo, jeżeli polecenie nie jest od parametrów oddzielone białym
+     * znakiem, dokładnie jeden dowolny znak.
+     * @param[in, out] line - pojedyncza, przycięta linia wejścia. Jeżeli
+     * polecenie zostało rozpoznane, napis jest o to polecenie obcięty;
      * @param[in] cmd - polecenie rozpoczynające linię.
      * @return Wartość true, jeżeli line rozpoczyna się napisem cmd,
      * false w przeciwnym przypadku.
      */
-    bool match_command(line_t &line, string const &cmd) {
-      if (line.rfind(cmd, 0) == 0) {
-        line.erase(0, cmd.length() + DELIM.length()); // Usuń następujący separator.
-        return true;
-      }
-      return false;
+    bool match_command(string_view &line, string_view const cmd) {
+      if (line.substr(0, cmd.length()) != cmd)
+        return false;
+
+      line.remove_prefix(cmd.length());
+      if (!line.empty() && is_space(line.front()))
+        trim_spaces(line);
+      else if (!line.empty())
+        line.remove_prefix(1);
+      return true;
     }
 
     /** Sprawdza polecenie, które jest wyznaczone przez pierwsze słowo wejścia.
-     * @param[in, out] line - linia wejścia z wyrazami oddzielonymi o napis
-     * DELIM, którą rozpoczyna polecenie. Po wykonaniu funkcji napis jest
-     * obcięty o polecenie.
+     * @param[in, out] line - przycięta linia wejścia, którą rozpoczyna
+     * polecenie. Po wykonaniu funkcji napis jest obcięty o polecenie.
      * @return Zwraca polecenie określone na wejściu.
      */
-    cmd_t parse_command(line_t &line) {
+    cmd_t parse_command(string_view &line) {
       cmd_t cmd = Vote;
       if (line.empty())
         cmd = Empty;
@@ -146,33 +128,57 @@ namespace {
       return cmd;
     }
 
-    /** Sprawdza, czy zapis liczb jest poprawny.
-     * Liczba nie może zaczynać się od zera, jeżeli zerem nie jest, ani
+    /** Odczytuje liczbę zaczynającą się na pozycji pos i sprawdza, czy jej
+     * zapis jest poprawny. Liczba nie może zaczynać się od zera ani
      * przekraczać długości NUM_LEN.
-     * @param[in, out] line - napis przedstawiający liczby oddzielone
-     * napisem DELIM.
-     * @return True, jeżeli nie ma błędnej liczby, false w przeciwnym razie.
+     * @param[in] line - skanowany napis;
+     * @param[in, out] pos - pozycja początku liczby. Po wykonaniu funkcji
+     * pierwsza pozycja za ostatnią wczytaną cyfrą;
+     * @param[out] number - odczytana liczba.
+     * @return True, jeżeli liczba jest poprawna, false w przeciwnym razie.
      */
-    bool validate_numbers(line_t const &line) {
-      return
-          !regex_search(DELIM + line, num_prefix0_expr) &&
-          !regex_search(line, num_len_expr);
+    bool scan_number(string_view const line, size_t &pos,
+                     track_id_t &number) {
+      size_t const begin = pos;
+      number = 0;
+
+      for (; pos < line.length() && is_digit(line[pos]); pos++) {
+        if (pos - begin == NUM_LEN)
+          return false;
+        number = number * 10 + (line[pos] - '0');
+      }
+      return pos > begin && line[begin] != '0';
     }
 
-    /** Sprawdza, czy parametry polecenia są poprawne.
-     * @param[in] line - napis następujący polecenie,
-     * @param[in] cmd - polecenie.
+    /** Sprawdza, czy parametry polecenia są poprawne, i odczytuje je.
+     * @param[in] line - przycięty napis następujący polecenie;
+     * @param[in] cmd - polecenie;
+     * @param[out] args - odczytane parametry polecenia.
      * @return True, jeżeli parametry spełniają specyfikacje polecenia,
      * false w przeciwnym razie albo wtedy, gdy polecenie nie jest rozpoznane.
      */
-    bool validate_parameters(line_t const &line, cmd_t const cmd) {
+    bool scan_parameters(string_view const line, cmd_t const cmd,
+                         track_ids_t &args) {
+      size_t pos = 0;
+      track_id_t number;
+
       switch (cmd) {
         case Vote:
-          return regex_match(line, digits_spaces_expr) &&
-                 validate_numbers(line);
+          while (scan_number(line, pos, number)) {
+            args.push_back(number);
+            if (pos == line.length())
+              return true;
+            if (!is_space(line[pos]))
+              return false;
+            while (is_space(line[pos])) // Linia nie kończy się białym znakiem.
+              pos++;
+          }
+          return false;
         case New:
-          return regex_match(line, only_digits_expr) &&
-                 validate_numbers(line);
+          if (!scan_number(line, pos, number) || pos != line.length())
+            return false;
+          args.push_back(number);
+          return true;
         case Top:
           return line.empty();
         case Empty:
@@ -181,319 +187,1766 @@ namespace {
           return false;
       }
     }
-  }
-
-  /// Funkcje przeznaczone do notowań.
-  namespace hit_list::list {
 
-    /** Wyrzuca utwory z głosowania.
-     * @param previous - poprzednie notowanie;
-     * @param current - obecne notowanie;
-     * @param dropped - utwory, które wypadły.
+    /** Odczytuje z początku linii przedrostek wybierający listę przebojów:
+     * CHART_MARK, nazwę listy i opcjonalnie TOP_COUNT_MARK z liczbą utworów
+     * w notowaniu, np. "@pop:20 NEW 100". Linia bez przedrostka należy do
+     * listy bez nazwy.
+     * @param[in, out] line - linia wejścia. Po wykonaniu funkcji obcięta
+     * o przedrostek;
+     * @param[out] name - nazwa listy;
+     * @param[out] top_count - liczba utworów w notowaniu albo 0, jeżeli
+     * jej nie podano.
+     * @return True, jeżeli przedrostek jest poprawny, false w przeciwnym
+     * razie (pusta nazwa lub niepoprawna liczba).
      */
-    void drop_tracks(unordered_ranks_t const &previous,
-                     unordered_ranks_t const &current,
-                     dropped_tracks_t &dropped) {
+    bool scan_chart(string_view &line, string_view &name,
+                    track_rank_t &top_count) {
+      string_view prefix = line;
+      trim_spaces(prefix);
+      name = string_view();
+      top_count = 0;
+
+      if (prefix.empty() || prefix.front() != CHART_MARK)
+        return true;
 
-      for (auto const &[id, rank]: previous) {
-        if (current.find(id) == current.end())
-          dropped.insert(id);
+      size_t end = 0;
+      while (end < prefix.length() && !is_space(prefix[end]))
+        end++;
+      line = prefix.substr(end);
+      name = prefix.substr(1, end - 1);
+
+      size_t const mark = name.find(TOP_COUNT_MARK);
+      if (mark != string_view::npos) {
+        string_view const count = name.substr(mark + 1);
+        size_t pos = 0;
+        name = name.substr(0, mark);
+        if (!scan_number(count, pos, top_count) || pos != count.length())
+          return false;
       }
+      return !name.empty();
     }
 
-    /** Resetuje głosy, aktualizuje max i zapisuje notowanie.
-     * @param previous - poprzednie notowanie;
-     * @param current - obecne notowanie;
-     * @param poll - głosy;
-     * @param max - maksymalny indeks dostępnych utworów.
+    /// Początkowy rozmiar bufora wczytywanego z wejścia strumieniowego.
+    size_t const CHUNK_SIZE = 1 << 20;
+
+    /** Czytnik wejścia dzielący je na linie bez kopiowania ich do osobnych
+     * napisów. Plik podany z nazwy jest mapowany do pamięci w całości,
+     * a deskryptor (standardowe wejście) czytany jest funkcją read() do
+     * bufora rozmiaru co najmniej CHUNK_SIZE. Funkcja read() oddaje dane,
+     * gdy tylko są dostępne, więc linie z terminala lub potoku są
+     * przetwarzane na bieżąco, a nie dopiero po zapełnieniu bufora.
+     * Zwrócona linia pozostaje ważna, dopóki next() nie wczyta kolejnego
+     * bloku, a więc co najmniej do następnego wywołania next().
      */
-    void initialize_listing(unordered_ranks_t &previous,
-                            unordered_ranks_t &current,
-                            count_per_track_t &poll,
-                            track_id_t const &max) {
-      previous.swap(current);
-      previous[MAX_VOTE_ID] = max;
+    class line_reader {
+    public:
+      explicit line_reader(int const input_fd)
+          : input_fd(input_fd), buffer(CHUNK_SIZE) {}
+
+      explicit line_reader(char const *path) {
+        int const fd = open(path, O_RDONLY);
+        struct stat st{};
+
+        if (fd < 0 || fstat(fd, &st) < 0) {
+          mapped = MAP_FAILED;
+        } else if (st.st_size > 0) {
+          mapped_size = st.st_size;
+          mapped = mmap(nullptr, mapped_size, PROT_READ, MAP_PRIVATE, fd, 0);
+          if (mapped != MAP_FAILED) {
+            madvise(mapped, mapped_size, MADV_SEQUENTIAL);
+            data = string_view(static_cast<char const *>(mapped),
+                               mapped_size);
+          }
+        }
+        if (fd >= 0)
+          close(fd);
+      }
+
+      line_reader(line_reader const &) = delete;
+      line_reader &operator=(line_reader const &) = delete;
+
+      ~line_reader() {
+        if (mapped_size > 0 && mapped != MAP_FAILED)
+          munmap(mapped, mapped_size);
+      }
+
+      /// Czy źródło wejścia zostało poprawnie otwarte.
+      bool is_open() const {
+        return mapped != MAP_FAILED;
+      }
+
+      /** Pobiera kolejną linię wejścia, bez znaku końca linii. Ostatnia
+       * linia nie musi być zakończona znakiem końca linii.
+       * @param[out] line - kolejna linia.
+       * @return Wartość false, jeżeli wejście się skończyło, true
+       * w przeciwnym razie.
+       */
+      bool next(line_t &line) {
+        while (!next_buffered(line)) {
+          if (!refill()) {
+            if (data.empty())
+              return false;
+            line = data;
+            data = string_view();
+            break;
+          }
+        }
+        return true;
+      }
+
+      /** Wczytuje wejście do końca i zwraca jego nieprzetworzoną część.
+       * @return Pozostała część wejścia, ważna do zniszczenia czytnika.
+       */
+      string_view rest() {
+        while (refill()) {}
+        string_view const rest = data;
+        data = string_view();
+        return rest;
+      }
+
+      /** Pobiera kolejną linię zakończoną znakiem końca linii, jeżeli jest
+       * już w buforze. Nie wczytuje nowego bloku, więc linie pobrane
+       * wcześniej pozostają ważne.
+       * @param[out] line - kolejna linia.
+       * @return Wartość true, jeżeli w buforze była cała linia, false
+       * w przeciwnym razie.
+       */
+      bool next_buffered(line_t &line) {
+        size_t const end = data.find('\n');
+        if (end == string_view::npos)
+          return false;
+
+        line = data.substr(0, end);
+        data.remove_prefix(end + 1);
+        return true;
+      }
+
+    private:
+      /// Czytany deskryptor albo -1, jeżeli wejście jest odwzorowane
+      /// w pamięci lub się skończyło.
+      int input_fd = -1;
+      vector<char> buffer;
+      string_view data;
+      void *mapped = nullptr;
+      size_t mapped_size = 0;
+
+      /** Dokłada do niewykorzystanej części bufora to, co jest dostępne na
+       * wejściu, czekając tylko wtedy, gdy nie ma nic. Jeżeli
+       * niewykorzystana część wypełnia cały bufor, bufor jest powiększany
+       * dwukrotnie.
+       * @return Wartość true, jeżeli wczytano nowe dane, false w przeciwnym
+       * razie (koniec wejścia lub błąd odczytu).
+       */
+      bool refill() {
+        if (input_fd < 0)
+          return false;
+
+        // Na początku data jest pusty i nie wskazuje na bufor.
+        size_t const kept = data.length();
+        if (kept > 0)
+          memmove(buffer.data(), data.data(), kept);
+        if (kept == buffer.size())
+          buffer.resize(2 * buffer.size());
+
+        ssize_t got;
+        do {
+          got = read(input_fd, buffer.data() + kept, buffer.size() - kept);
+        } while (got < 0 && errno == EINTR);
+
+        data = string_view(buffer.data(), kept + (got > 0 ? got : 0));
+        if (got <= 0)
+          input_fd = -1;
+        return got > 0;
+      }
+    };
 
-      poll = count_per_track_t();
+    /// Rozmiar bufora wyjścia, po którego zapełnieniu bufor jest opróżniany.
+    size_t const OUTPUT_BUFFER_SIZE = 1 << 16;
+
+    /** Buforowane wyjście do deskryptora pliku. Bufor jest opróżniany po
+     * zapełnieniu, na żądanie, po każdej linii w trybie liniowym oraz przy
+     * niszczeniu obiektu. Dwa połączone obiekty (wyjście standardowe
+     * i diagnostyczne) nigdy nie mają naraz niepustych buforów: przed
+     * zapisem do jednego opróżniany jest drugi, więc kolejność linii jest
+     * zachowana, także gdy oba trafiają do tego samego pliku.
+     */
+    class writer {
+    public:
+      explicit writer(int const fd) : fd(fd) {
+        buffer.reserve(OUTPUT_BUFFER_SIZE);
+      }
+
+      /// Tworzy wyjście połączone z @p peer.
+      writer(int const fd, writer &peer) : writer(fd) {
+        this->peer = &peer;
+        peer.peer = this;
+      }
+
+      writer(writer const &) = delete;
+      writer &operator=(writer const &) = delete;
+
+      ~writer() {
+        flush();
+      }
+
+      /// Czy opróżniać bufor po każdej linii.
+      void set_line_buffered(bool const value) {
+        line_buffered = value;
+      }
+
+      writer &operator<<(string_view const text) {
+        prepare(text.length());
+        buffer.insert(buffer.end(), text.begin(), text.end());
+        return *this;
+      }
+
+      writer &operator<<(char const c) {
+        prepare(1);
+        buffer.push_back(c);
+        return *this;
+      }
+
+      /// Zapisuje liczbę bez pośrednictwa strumieni i lokalizacji.
+      template <std::integral T>
+      writer &operator<<(T const number) {
+        char digits[24];
+        auto const result = std::to_chars(digits, digits + sizeof(digits),
+                                          number);
+        return *this << string_view(digits, result.ptr - digits);
+      }
+
+      /// Kończy linię.
+      void end_line() {
+        *this << '\n';
+        if (line_buffered)
+          flush();
+      }
+
+      /// Zapisuje zawartość bufora.
+      void flush() {
+        size_t done = 0;
+        while (done < buffer.size()) {
+          ssize_t const n = ::write(fd, buffer.data() + done,
+                                    buffer.size() - done);
+          if (n < 0 && errno == EINTR)
+            continue;
+          if (n <= 0)
+            break;
+          done += n;
+        }
+        buffer.clear();
+      }
+
+    private:
+      int fd;
+      writer *peer = nullptr;
+      bool line_buffered = false;
+      vector<char> buffer;
+
+      /// Robi w buforze miejsce na n znaków, opróżniając bufor połączonego
+      /// wyjścia, a w razie potrzeby także własny.
+      void prepare(size_t const n) {
+        if (peer && !peer->buffer.empty())
+          peer->flush();
+        if (buffer.size() + n > OUTPUT_BUFFER_SIZE)
+          flush();
+      }
+    };
+
+    /// Wyjście standardowe i diagnostyczne.
+    writer out(STDOUT_FILENO);
+    writer err(STDERR_FILENO, out);
+  }
+
+  /** Wypisuje notowanie (podsumowanie) na wyjście standardowe. Obok numeru
+   * utworu wypisywana jest różnica jego pozycji w poprzednim i obecnym
+   * rankingu albo RANK_NO_CHANGE, jeżeli w poprzednim rankingu go nie było.
+   * @param[in] label - napis poprzedzający każdą linię rankingu;
+   * @param[in] ranking - notowanie (podsumowanie) uporządkowane według
+   * pozycji.
+   */
+  void print_top7(string const &label, ranking_t const &ranking) {
+    using IO::DELIM, IO::RANK_NO_CHANGE;
+
+    for (top7::ranked_track const &track: ranking) {
+      IO::out << label << track.id << DELIM;
+      if (!track.previous_rank)
+        IO::out << RANK_NO_CHANGE;
+      else
+        IO::out << track.previous_rank - track.rank;
+      IO::out.end_line();
+    }
+  }
+
+  /// Kompilowanie z parametrem -DTOP7_STATS włącza liczniki statystyk
+  /// przetwarzania (patrz stats). Bez niego liczniki nic nie kosztują.
+#ifdef TOP7_STATS
+  bool const collect_stats = true;
+#else
+  bool const collect_stats = false;
+#endif
+
+  /** Statystyki przetwarzania: liczba poprawnych linii każdego rodzaju,
+   * liczba linii niepoprawnych według powodu, łączny czas faz przetwarzania
+   * linii oraz zapełnienie tablic haszujących. Wypisywane na wyjście
+   * diagnostyczne po otrzymaniu sygnału SIGUSR1 i na końcu działania.
+   */
+  namespace stats {
+
+    using clock_t = std::chrono::steady_clock;
+
+    /// Powody odrzucenia linii.
+    enum reason_t {
+      BadFormat, OutOfRange, Dropped, Repeated, MaxDecreased, REASONS
+    };
+
+    /// Fazy przetwarzania linii.
+    enum phase_t {
+      Parse, Validate, Update, Ranking, PHASES
+    };
+
+    /// Zebrane liczniki.
+    struct counters_t {
+      /// Poprawne linie według rodzaju polecenia.
+      array<size_t, 4> commands{};
+      /// Niepoprawne linie według powodu.
+      array<size_t, REASONS> invalid{};
+      /// Łączny czas i liczba pomiarów każdej fazy.
+      array<clock_t::duration, PHASES> time{};
+      array<size_t, PHASES> timed{};
+    };
+
+    counters_t counters;
+
+    /// Ustawiane przez obsługę sygnału SIGUSR1.
+    volatile std::sig_atomic_t report_requested = 0;
+
+    void request_report(int) {
+      report_requested = 1;
     }
+
+    /** Mierzy czas fazy od utworzenia do zniszczenia obiektu. Pomiary są
+     * dopisywane do wspólnych liczników, więc wolno mierzyć tylko w wątku,
+     * który przetwarza linie po kolei.
+     */
+    class timer {
+    public:
+      explicit timer(phase_t const phase)
+          : phase(phase),
+            start(collect_stats ? clock_t::now() : clock_t::time_point()) {}
+
+      ~timer() {
+        if (collect_stats) {
+          counters.time[phase] += clock_t::now() - start;
+          counters.timed[phase]++;
+        }
+      }
+
+    private:
+      phase_t phase;
+      clock_t::time_point start;
+    };
   }
 
-  /// Funkcje przeznaczone do głosowań.
-  namespace hit_list::poll {
-
-    /** Pobiera z napisu głosy i sprawdza, czy są poprawne.
-     * @param[in, out] votes - głosy na daną linijkę;
-     * @param[in] dropped - utwory, które wypadły z głosowania;
-     * @param[in] line - linijka zawierająca głosy;
-     * @param[in] max - maksymalny indeks utworu.
-     * @return Wartość true, jeżeli dane są poprawne, wartość false w
-     * przeciwnym razie. (Niepoprawne, jeżeli utwór przepadł lub głos
-     * jest oddany ponad max).
+  /** Lista przebojów sterowana poleceniami z linii tekstu: silnik
+   * top7::chart wraz z napisem poprzedzającym wypisywane notowania.
+   */
+  class chart {
+  public:
+    /** @param[in] label - napis poprzedzający każdą wypisywaną linię
+     * notowania (podsumowania);
+     * @param[in] top_count - liczba utworów w notowaniu (podsumowaniu);
+     * @param[in] window - liczba ostatnich notowań liczonych do
+     * podsumowania albo 0 dla wszystkich.
      */
-    bool fetch_votes(vote_set_t &votes, dropped_tracks_t const &dropped,
-                     line_t const &line, track_id_t const &max) {
+    chart(string label, track_rank_t const top_count, size_t const window)
+        : label(std::move(label)), engine(top_count, window) {}
+
+    track_rank_t get_top_count() const {
+      return engine.get_top_count();
+    }
+
+    size_t get_window() const {
+      return engine.get_window();
+    }
+
+    bool check_vote(track_span_t const ids) const {
+      return engine.check_vote(ids);
+    }
+
+    void add_votes(count_per_track_t const &votes) {
+      engine.add_votes(votes);
+    }
 
-      bool valid_arguments = true;
-      track_id_t track_id;
-      istringstream stream(line);
+    void save(ostream &out) const {
+      engine.save(out);
+    }
+
+    top7::memory_t memory() const {
+      return engine.memory();
+    }
+
+    top7::vote_error_t vote_error(track_span_t const ids) const {
+      return engine.vote_error(ids);
+    }
 
-      while (stream >> track_id && valid_arguments) {
-        if (track_id > max || dropped.count(track_id) || votes.count(track_id))
-          valid_arguments = false;
+    bool load(top7::snapshot::input &in) {
+      return engine.load(in);
+    }
 
-        votes.insert(track_id);
+    /** Uruchamia listę przebojów. Jeżeli kończy działanie wartością false,
+     * to nie zachodzą żadne zmiany w strukturach danych.
+     * @param[in] cmd - typ polecenia;
+     * @param[in] args - parametry polecenia.
+     * @return Wartość true, jeżeli dane są poprawne, false w przeciwnym
+     * razie.
+     */
+    bool run(cmd_t const &cmd, track_span_t const args) {
+      switch (cmd) {
+        case New: {
+          stats::timer const t(stats::Ranking);
+          if (!engine.new_listing(args.front(), ranking))
+            return false;
+          print_top7(label, ranking);
+          return true;
+        }
+        case Vote: {
+          {
+            stats::timer const t(stats::Validate);
+            if (!engine.check_vote(args))
+              return false;
+          }
+          stats::timer const t(stats::Update);
+          engine.add_vote(args);
+          return true;
+        }
+        case Top: {
+          stats::timer const t(stats::Ranking);
+          engine.top(ranking);
+          print_top7(label, ranking);
+          return true;
+        }
+        default:
+          return true; // tu będzie Empty
       }
-      return valid_arguments;
     }
 
-    /** Aktualizuje liczbę głosów na każdy utwór.
-     * @param poll - aktualne głosy w bieżącym głosowaniu;
-     * @param votes - głosy w danej linijce.
+  private:
+    string label;
+    top7::chart engine;
+    /// Bufor na wypisywane notowanie.
+    ranking_t ranking;
+  };
+
+  /// Funkcja haszująca nazwy list przebojów, pozwalająca szukać listy po
+  /// string_view bez tworzenia napisu.
+  struct name_hash {
+    using is_transparent = void;
+
+    size_t operator()(string_view const name) const {
+      return std::hash<string_view>()(name);
+    }
+  };
+
+  /// Listy przebojów według nazw. Lista bez nazwy obsługuje linie bez
+  /// przedrostka.
+  using charts_t = unordered_map<string, chart, name_hash, std::equal_to<>>;
+
+  /** Wypisuje komunikat o błędzie w linii na wejściu diagnostycznym.
+   * @param[in] num - numer linii;
+   * @param[in] line - linia na której jest błąd.
+   */
+  void error_write(line_num_t const &num, line_t const &line) {
+    IO::err << "Error in line " << num << ": " << line;
+    IO::err.end_line();
+  }
+
+  /** Wypisuje na wyjście diagnostyczne komunikat o nieudanej operacji na
+   * pliku.
+   * @param[in] message - opis operacji;
+   * @param[in] path - ścieżka pliku.
+   */
+  void report_failure(string_view const message, string_view const path) {
+    IO::err << message << path;
+    IO::err.end_line();
+  }
+
+  /** Jednym przejściem oczyszcza linię wejścia ze zbędnych białych znaków,
+   * rozpoznaje polecenie, sprawdza jej poprawność i odczytuje parametry.
+   * @param[in, out] cmd - rodzaj polecenia;
+   * @param[in] line - skanowany napis;
+   * @param[in, out] args - wektor, na którego koniec dopisywane są
+   * parametry polecenia.
+   * @return Wartość true, jeżeli dane są poprawne; wartość false w
+   * przeciwnym razie.
+   */
+  bool parse_line(cmd_t &cmd, string_view line, track_ids_t &args) {
+    using namespace IO;
+    trim_spaces(line);
+    cmd = parse_command(line);
+    return scan_parameters(line, cmd, args);
+  }
+
+  /** Wybiera listę przebojów o podanej nazwie. Listę o nowej nazwie tworzy
+   * z liczbą utworów w notowaniu podaną w przedrostku albo domyślną.
+   * @param[in, out] charts - listy przebojów;
+   * @param[in] name - nazwa listy, pusta dla linii bez przedrostka;
+   * @param[in] top_count - liczba utworów w notowaniu z przedrostka albo 0;
+   * @param[in] default_top_count - domyślna liczba utworów w notowaniu;
+   * @param[in] window - liczba ostatnich notowań liczonych do podsumowania
+   * nowej listy albo 0 dla wszystkich.
+   * @return Wybrana lista albo nullptr, jeżeli przedrostek podaje inną
+   * liczbę utworów niż ta, z którą lista została utworzona.
+   */
+  chart *find_chart(charts_t &charts, string_view const name,
+                    track_rank_t const top_count,
+                    track_rank_t const default_top_count,
+                    size_t const window) {
+    using namespace IO;
+
+    auto it = charts.find(name);
+    if (it == charts.end()) {
+      string label = name.empty() ? string()
+                                  : CHART_MARK + string(name) + DELIM;
+      it = charts.try_emplace(string(name), std::move(label),
+                              top_count ? top_count : default_top_count,
+                              window).first;
+    } else if (top_count && top_count != it->second.get_top_count()) {
+      return nullptr;
+    }
+    return &it->second;
+  }
+
+  /** Wybiera listę przebojów według przedrostka linii.
+   * @param[in, out] charts - listy przebojów;
+   * @param[in, out] line - linia wejścia, po wykonaniu funkcji obcięta
+   * o przedrostek;
+   * @param[in] default_top_count - domyślna liczba utworów w notowaniu;
+   * @param[in] window - liczba ostatnich notowań liczonych do podsumowania
+   * nowej listy albo 0 dla wszystkich.
+   * @return Wybrana lista albo nullptr, jeżeli przedrostek jest niepoprawny
+   * lub podaje inną liczbę utworów niż ta, z którą lista została utworzona.
+   */
+  chart *select_chart(charts_t &charts, line_t &line,
+                      track_rank_t const default_top_count,
+                      size_t const window) {
+    string_view name;
+    track_rank_t top_count;
+
+    if (!IO::scan_chart(line, name, top_count))
+      return nullptr;
+    return find_chart(charts, name, top_count, default_top_count, window);
+  }
+
+  /// Opcje wywołania programu.
+  struct options_t {
+    /// Plik z głosami albo nullptr dla standardowego wejścia.
+    char const *path = nullptr;
+    /// Czy linie mogą zaczynać się przedrostkiem listy.
+    bool routing = false;
+    /// Domyślna liczba utworów w notowaniu.
+    track_rank_t top_count = DEFAULT_TOP_COUNT;
+    /// Liczba wątków zliczających głosy.
+    unsigned threads = 1;
+    /// Liczba ostatnich notowań, z których punkty liczą się do
+    /// podsumowania, albo 0 dla wszystkich notowań.
+    size_t window = 0;
+    /// Plik stanu list przebojów albo nullptr.
+    char const *state_path = nullptr;
+    /// Co ile linii zapisywać stan, 0 oznacza zapis tylko na końcu.
+    line_num_t save_every = 0;
+    /// Czy opróżniać bufory wyjścia po każdej linii.
+    bool line_buffered = false;
+    /// Co ile linii wejścia opróżniać bufory wyjścia, 0 oznacza brak
+    /// okresowego opróżniania.
+    line_num_t flush_every = 0;
+    /// Czy mierzyć przepustowość i czasy wykonania poleceń.
+    bool benchmark = false;
+    /// Plik, do którego zamienić wejście tekstowe na dziennik binarny, albo
+    /// nullptr.
+    char const *log_path = nullptr;
+    /// Czy wejście jest dziennikiem binarnym.
+    bool binary = false;
+  };
+
+  /** Zapisuje stan wszystkich list przebojów do pliku. Stan jest najpierw
+   * zapisywany do pliku tymczasowego, który następnie zastępuje plik
+   * docelowy, więc przerwany zapis nie niszczy poprzedniego stanu.
+   * @param[in] charts - listy przebojów;
+   * @param[in] path - ścieżka pliku stanu.
+   * @return Wartość true, jeżeli zapis się powiódł, false w przeciwnym
+   * razie.
+   */
+  bool save_charts(charts_t const &charts, char const *path) {
+    using namespace top7::snapshot;
+    string const tmp_path = string(path) + ".tmp";
+    ofstream out(tmp_path, std::ios::binary);
+
+    out.write(MAGIC.data(), MAGIC.length());
+    write(out, (size_record) charts.size());
+    for (auto const &[name, chart]: charts) {
+      write(out, (size_record) name.length());
+      out.write(name.data(), name.length());
+      chart.save(out);
+    }
+
+    out.close();
+    return out && std::rename(tmp_path.c_str(), path) == 0;
+  }
+
+  /** Odczytuje stan list przebojów zapisany przez save_charts(). Listy
+   * z pliku zastępują listy o tych samych nazwach, razem z liczbą utworów
+   * w notowaniu i oknem notowań. Brak pliku oznacza, że nie ma stanu do odtworzenia.
+   * @param[in, out] charts - listy przebojów;
+   * @param[in] path - ścieżka pliku stanu;
+   * @param[in] default_top_count - domyślna liczba utworów w notowaniu.
+   * @return Wartość false, jeżeli plik istnieje, ale nie da się go odczytać
+   * lub jest niepoprawny, true w przeciwnym razie.
+   */
+  bool load_charts(charts_t &charts, char const *path,
+                   track_rank_t const default_top_count) {
+    using namespace top7::snapshot;
+    ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+      return true;
+
+    string contents(file.tellg(), '\0');
+    file.seekg(0);
+    if (!file.read(contents.data(), contents.length()))
+      return false;
+
+    if (!contents.starts_with(MAGIC))
+      return false;
+
+    input in(string_view(contents).substr(MAGIC.length()));
+    size_record count;
+    if (!in.read(count))
+      return false;
+
+    for (size_record i = 0; i < count; i++) {
+      string name;
+      if (!in.read_string(name) ||
+          !find_chart(charts, name, 0, default_top_count, 0)->load(in))
+        return false;
+    }
+    return in.empty();
+  }
+
+  /** Zapisuje stan list przebojów, jeżeli od poprzedniego zapisu
+   * przetworzono co najmniej tyle linii, ile podano w opcjach.
+   * @param[in] charts - listy przebojów;
+   * @param[in] options - opcje wywołania;
+   * @param[in, out] saved - liczba linii przetworzonych przed poprzednim
+   * zapisem;
+   * @param[in] line_num - liczba przetworzonych linii.
+   */
+  void periodic_save(charts_t const &charts, options_t const &options,
+                     line_num_t &saved, line_num_t const line_num) {
+    if (options.save_every && line_num - saved >= options.save_every) {
+      if (!save_charts(charts, options.state_path))
+        report_failure("Cannot save ", options.state_path);
+      saved = line_num;
+    }
+  }
+
+  /** Opróżnia bufory wyjścia, jeżeli od poprzedniego opróżnienia
+   * przetworzono co najmniej tyle linii, ile podano w opcjach.
+   * @param[in] options - opcje wywołania;
+   * @param[in, out] flushed - liczba linii przetworzonych przed poprzednim
+   * opróżnieniem;
+   * @param[in] line_num - liczba przetworzonych linii.
+   */
+  void periodic_flush(options_t const &options, line_num_t &flushed,
+                      line_num_t const line_num) {
+    if (options.flush_every && line_num - flushed >= options.flush_every) {
+      IO::err.flush();
+      IO::out.flush();
+      flushed = line_num;
+    }
+  }
+
+  namespace stats {
+
+    /** Zlicza przetworzoną linię.
+     * @param[in] target - lista wybrana dla linii albo nullptr;
+     * @param[in] parsed - czy linia została poprawnie sparsowana;
+     * @param[in] cmd, args - polecenie i jego parametry, jeżeli parsed;
+     * @param[in] valid - czy linia została wykonana.
+     */
+    void count_line(chart const *target, bool const parsed, cmd_t const cmd,
+                    track_span_t const args, bool const valid) {
+      if (valid) {
+        counters.commands[cmd]++;
+        return;
+      }
+
+      reason_t reason = BadFormat;
+      if (target && parsed && cmd == New) {
+        reason = MaxDecreased;
+      } else if (target && parsed && cmd == Vote) {
+        switch (target->vote_error(args)) {
+          case top7::VoteOutOfRange:
+            reason = OutOfRange;
+            break;
+          case top7::VoteDropped:
+            reason = Dropped;
+            break;
+          default:
+            reason = Repeated;
+            break;
+        }
+      }
+      counters.invalid[reason]++;
+    }
+
+    /// Wypisuje "nazwa rozmiar/kubełki" dla tablicy haszującej.
+    void write_load(string_view const name, size_t const size,
+                    size_t const buckets) {
+      IO::err << " " << name << " " << size << "/" << buckets;
+    }
+
+    /** Wypisuje statystyki na wyjście diagnostyczne.
+     * @param[in] charts - listy przebojów.
      */
-    void update_poll(count_per_track_t &poll,
-                     vote_set_t const &votes) {
+    void report(charts_t const &charts) {
+      array<string_view, 4> const commands{"vote", "new", "top", "empty"};
+      array<string_view, REASONS> const reasons{
+          "format", "range", "dropped", "repeated", "max"};
+      array<string_view, PHASES> const phases{
+          "parse", "validate", "update", "ranking"};
+
+      IO::err << "stats lines";
+      for (size_t i = 0; i < commands.size(); i++)
+        IO::err << " " << commands[i] << " " << counters.commands[i];
+      IO::err.end_line();
+
+      IO::err << "stats invalid";
+      for (size_t i = 0; i < reasons.size(); i++)
+        IO::err << " " << reasons[i] << " " << counters.invalid[i];
+      IO::err.end_line();
+
+      IO::err << "stats time";
+      for (size_t i = 0; i < phases.size(); i++) {
+        auto const ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            counters.time[i]).count();
+        IO::err << " " << phases[i] << " " << ns << "ns/"
+                << counters.timed[i];
+      }
+      IO::err.end_line();
+
+      IO::err << "stats load";
+      write_load("charts", charts.size(), charts.bucket_count());
+      IO::err.end_line();
+      for (auto const &[name, chart]: charts) {
+        top7::memory_t const m = chart.memory();
+        IO::err << "stats load " << IO::CHART_MARK << name;
+        write_load("points", m.points_tracks, m.points_buckets);
+        write_load("poll", m.poll_tracks, m.poll_buckets);
+        IO::err.end_line();
+      }
+      IO::err.flush();
+    }
 
-      for (auto const &vote: votes)
-        poll[vote]++;
+    /// Wypisuje statystyki, jeżeli nadszedł sygnał SIGUSR1.
+    void report_if_requested(charts_t const &charts) {
+      if (collect_stats && report_requested) {
+        report_requested = 0;
+        report(charts);
+      }
     }
   }
 
-  /// Funkcje przeznaczone do podsumowań.
-  namespace hit_list::top {
+  /** Pomiar wydajności: liczba linii na sekundę dla całego wejścia,
+   * rozkład czasów wykonania poleceń głosowania, NEW i TOP oraz, dla
+   * porównania, przepustowość tych samych poleceń wykonanych bezpośrednio
+   * na silniku top7::chart, bez parsowania i wypisywania tekstu, a także
+   * czas parsowania próbki linii skanerem i wyrażeniami regularnymi.
+   */
+  namespace bench {
+
+    using clock_t = std::chrono::steady_clock;
+    using nanoseconds_t = std::chrono::nanoseconds::rep;
+
+    /// Wypisywane percentyle czasów wykonania.
+    array<pair<string_view, double>, 4> const PERCENTILES{{
+        {"p50", 50}, {"p90", 90}, {"p99", 99}, {"p99.9", 99.9}}};
+
+    /// Zebrane czasy wykonania poleceń.
+    class recorder {
+    public:
+      recorder() : start(clock_t::now()) {}
+
+      /// Zapisuje czas wykonania polecenia rozpoczętego w chwili @p since.
+      void record(cmd_t const cmd, clock_t::time_point const since) {
+        if (cmd != Empty)
+          latencies[cmd].push_back(
+              std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  clock_t::now() - since).count());
+      }
+
+      /** Wypisuje wyniki pomiaru na wyjście diagnostyczne.
+       * @param[in] lines - liczba przetworzonych linii.
+       */
+      void report(line_num_t const lines) {
+        double const seconds = std::chrono::duration<double>(
+            clock_t::now() - start).count();
+        IO::err << "input lines " << lines << " seconds "
+                << std::to_string(seconds) << " lines/s "
+                << (line_num_t) (seconds > 0 ? lines / seconds : 0);
+        IO::err.end_line();
+
+        array<string_view, 3> const names{"vote", "new", "top"};
+        for (cmd_t const cmd: {Vote, New, Top}) {
+          vector<nanoseconds_t> &times = latencies[cmd];
+          if (times.empty())
+            continue;
+
+          sort(times.begin(), times.end());
+          IO::err << names[cmd] << " count " << times.size();
+          for (auto const &[label, p]: PERCENTILES) {
+            size_t const i = min(times.size() - 1,
+                                 (size_t) (p / 100 * times.size()));
+            IO::err << " " << label << " " << times[i] << "ns";
+          }
+          IO::err << " max " << times.back() << "ns";
+          IO::err.end_line();
+        }
+      }
 
-    string const DELIM = " ";
-    string const RANK_NO_CHANGE = "-";
+    private:
+      clock_t::time_point start;
+      array<vector<nanoseconds_t>, 3> latencies;
+    };
 
-    /**
-     * Porównuje punktację dwóch utworów.
-     * @param a - para zawierająca numer pierwszego utworu oraz liczbę jego
-     * punktów.
-     * @param b - para zawierająca numer drugiego utworu oraz liczbę jego
-     * punktów.
-     * @return @p true, jeśli pierwszy utwór jest wyżej w rankingu, @p false
-     * w przeciwnym wypadku.
+    /** Wypisuje na wyjście diagnostyczne przybliżoną pamięć zajmowaną przez
+     * każdą listę przebojów.
+     * @param[in] charts - listy przebojów.
      */
-    bool compare_points(top7_pair const &a, top7_pair const &b) {
-      if (a.second == b.second)
-        return a.first < b.first;
-      else
-        return a.second > b.second;
+    void report_memory(charts_t const &charts) {
+      for (auto const &[name, chart]: charts) {
+        top7::memory_t const m = chart.memory();
+        IO::err << "memory " << IO::CHART_MARK << name
+                << " points " << m.points_tracks << " tracks "
+                << m.points_bytes << "B dropped " << m.dropped_tracks
+                << " tracks " << m.dropped_bytes << "B poll " << m.poll_bytes
+                << "B window " << m.window_bytes << "B compacted "
+                << m.compacted_tracks << " tracks";
+        IO::err.end_line();
+      }
     }
 
-    /** Tworzy ranking siedmiu najlepszych utworów na podstawie zdobytych
-     * przez nie punktów.
-     * @param[in] points - mapa zawierająca numery i związane z nimi liczby
-     * punktów.
-     * @return Zwraca parę zawierającą odpowiednio ranking dostępny po
-     * numerze utworu (bez zachowania porządku), oraz ranking dostępny po
-     * pozycji utworu.
+    /// Poprawnie sparsowane polecenia, wykonywane ponownie na silniku.
+    class replay {
+    public:
+      void add(chart const *target, cmd_t const cmd,
+               track_span_t const args) {
+        if (cmd != Empty) {
+          commands.push_back({target, cmd, all_args.size(), args.size()});
+          all_args.insert(all_args.end(), args.begin(), args.end());
+        }
+      }
+
+      /// Wykonuje polecenia na nowych listach o tej samej liczbie utworów
+      /// w notowaniu i tym samym oknie notowań i wypisuje przepustowość na
+      /// wyjście diagnostyczne.
+      void report() {
+        unordered_map<chart const *, top7::chart> engines;
+        vector<top7::chart *> targets;
+        ranking_t ranking;
+
+        if (commands.empty())
+          return;
+        for (command_t const &c: commands)
+          targets.push_back(&engines.try_emplace(
+              c.target, c.target->get_top_count(),
+              c.target->get_window()).first->second);
+
+        clock_t::time_point const start = clock_t::now();
+        for (size_t i = 0; i < commands.size(); i++) {
+          command_t const &c = commands[i];
+          track_span_t const args =
+              track_span_t(all_args).subspan(c.args_begin, c.args_count);
+          switch (c.cmd) {
+            case Vote:
+              targets[i]->vote(args);
+              break;
+            case New:
+              targets[i]->new_listing(args.front(), ranking);
+              break;
+            default:
+              targets[i]->top(ranking);
+              break;
+          }
+        }
+        double const seconds = std::chrono::duration<double>(
+            clock_t::now() - start).count();
+
+        IO::err << "api commands " << commands.size() << " seconds "
+                << std::to_string(seconds) << " commands/s "
+                << (size_t) (seconds > 0 ? commands.size() / seconds : 0);
+        IO::err.end_line();
+      }
+
+    private:
+      struct command_t {
+        chart const *target;
+        cmd_t cmd;
+        size_t args_begin, args_count;
+      };
+
+      vector<command_t> commands;
+      track_ids_t all_args;
+    };
+
+    /// Największa liczba linii, na których porównywane są parsery.
+    size_t const PARSE_SAMPLE_LINES = 1 << 16;
+
+    /** Parser linii sprzed wprowadzenia skanera: zamienia ciągi białych
+     * znaków na IO::DELIM, rozpoznaje polecenie, sprawdza parametry
+     * wyrażeniami regularnymi i odczytuje je strumieniem. Przyjmuje te same
+     * linie co parse_line() i służy tylko do porównania z nią.
+     * @param[out] cmd - rodzaj polecenia;
+     * @param[in] line - linia wejścia bez przedrostka listy;
+     * @param[in, out] args - wektor, na którego koniec dopisywane są
+     * parametry polecenia.
+     * @return Wartość true, jeżeli dane są poprawne; wartość false w
+     * przeciwnym razie.
      */
-    pair<unordered_ranks_t, ordered_ranks_t>
-    fetch_ranking(count_per_track_t const &points) {
+    bool regex_parse_line(cmd_t &cmd, string line, track_ids_t &args) {
+      using std::regex;
+      using IO::DELIM;
+      static regex const whitespace_expr("[[:space:]]+");
+      static regex const num_prefix0_expr(DELIM + "0");
+      static regex const num_len_expr(
+          "[0-9]{" + std::to_string(IO::NUM_LEN + 1) + "}");
+      static regex const only_digits_expr("[0-9]+");
+      static regex const digits_spaces_expr("[0-9[:space:]]+");
+
+      string const whitespace(IO::whitespace_str);
+      line.erase(line.find_last_not_of(whitespace) + 1);
+      line.erase(0, line.find_first_not_of(whitespace));
+      line = regex_replace(line, whitespace_expr, DELIM);
 
-      top7_t ranking(points.begin(), points.end());
-      sort(ranking.begin(), ranking.end(), compare_points);
+      cmd = Vote;
+      if (line.empty())
+        cmd = Empty;
+      else if (line.rfind(IO::NEW, 0) == 0)
+        cmd = New;
+      else if (line.rfind(IO::TOP, 0) == 0)
+        cmd = Top;
+      if (cmd == New || cmd == Top) // Usuń też następujący separator.
+        line.erase(0, (cmd == New ? IO::NEW : IO::TOP).length() +
+                      DELIM.length());
 
-      track_id_t id;
-      unordered_ranks_t updated_ranking;
-      ordered_ranks_t sorted_updated_ranking;
+      bool const valid_numbers =
+          !regex_search(DELIM + line, num_prefix0_expr) &&
+          !regex_search(line, num_len_expr);
+      switch (cmd) {
+        case Vote:
+          if (!regex_match(line, digits_spaces_expr) || !valid_numbers)
+            return false;
+          break;
+        case New:
+          if (!regex_match(line, only_digits_expr) || !valid_numbers)
+            return false;
+          break;
+        case Top:
+          return line.empty();
+        default:
+          return true;
+      }
 
-      for (size_t rank = 1;
-           rank <= min((size_t) TOP_COUNT, ranking.size()); rank++) {
+      std::istringstream stream(line);
+      for (track_id_t id; stream >> id;)
+        args.push_back(id);
+      return true;
+    }
+
+    /** Próbka linii wejścia, na której parse_line() jest porównywana
+     * z regex_parse_line(): oba parsery przetwarzają te same linie, a wynik
+     * to średni czas na linię i liczba linii, dla których ich wyniki się
+     * różnią.
+     */
+    class parse_compare {
+    public:
+      /// Zapamiętuje linię wejścia bez przedrostka listy.
+      void add(line_t const body) {
+        if (lines.size() < PARSE_SAMPLE_LINES)
+          lines.emplace_back(body);
+      }
+
+      /// Mierzy oba parsery i wypisuje wynik na wyjście diagnostyczne.
+      void report() const {
+        if (lines.empty())
+          return;
+
+        vector<parsed_t> scanned(lines.size()), matched(lines.size());
+        double const scanner_ns = measure(scanned, parse_line);
+        double const regex_ns = measure(matched, regex_parse_line);
+
+        size_t differences = 0;
+        for (size_t i = 0; i < lines.size(); i++) {
+          parsed_t const &a = scanned[i], &b = matched[i];
+          if (a.valid != b.valid ||
+              (a.valid && (a.cmd != b.cmd || a.args != b.args)))
+            differences++;
+        }
+
+        IO::err << "parse lines " << lines.size() << " scanner "
+                << std::to_string(scanner_ns) << "ns/line regex "
+                << std::to_string(regex_ns) << "ns/line differences "
+                << differences;
+        IO::err.end_line();
+      }
 
-        tie(id, std::ignore) = ranking[rank - 1];
-        sorted_updated_ranking.push_back({id, rank});
-        updated_ranking.insert({id, rank});
+    private:
+      struct parsed_t {
+        cmd_t cmd;
+        bool valid;
+        track_ids_t args;
+      };
+
+      /// Parsuje wszystkie linie funkcją @p parse i daje średni czas na
+      /// linię w nanosekundach.
+      template <typename Parse>
+      double measure(vector<parsed_t> &results, Parse parse) const {
+        clock_t::time_point const start = clock_t::now();
+        for (size_t i = 0; i < lines.size(); i++)
+          results[i].valid = parse(results[i].cmd, lines[i], results[i].args);
+        std::chrono::duration<double, std::nano> const time =
+            clock_t::now() - start;
+        return time.count() / lines.size();
       }
 
-      return {updated_ranking, sorted_updated_ranking};
+      vector<string> lines;
+    };
+  }
+
+  /** Przetwarzanie wejścia w blokach przez wiele wątków. Linie bloku są
+   * parsowane równolegle. Głosy z linii między kolejnymi poprawnymi NEW
+   * i TOP są sprawdzane równolegle i zliczane w licznikach lokalnych dla
+   * wątków, które są scalane przed wykonaniem tego polecenia. Głosy między
+   * dwoma NEW są przemienne, a ich poprawność zależy tylko od MAX i utworów,
+   * które wypadły, więc wynik, w tym kolejność komunikatów o błędach, jest
+   * taki sam jak przy przetwarzaniu linia po linii.
+   */
+  namespace batch {
+
+    /// Największa liczba linii w bloku.
+    size_t const BATCH_LINES = 1 << 16;
+
+    /// Najmniejsza liczba linii z głosami, dla której uruchamiane są wątki.
+    size_t const MIN_PARALLEL_LINES = 1 << 12;
+
+    /// Linia bloku po sparsowaniu.
+    struct parsed_line {
+      line_t line;
+      string_view name = string_view();
+      track_rank_t top_count = 0;
+      cmd_t cmd = Empty;
+      /// Czy linia została poprawnie sparsowana i czy jest poprawna.
+      bool parsed = false, valid = false;
+      /// Czy linia ma poprawny przedrostek listy. Taki przedrostek tworzy
+      /// listę nawet wtedy, gdy reszta linii jest niepoprawna.
+      bool routed = false;
+      chart *target = nullptr;
+      /// Wątek, który sparsował linię, i zakres jej parametrów w jego
+      /// wektorze args.
+      size_t worker = 0, args_begin = 0, args_end = 0;
+    };
+
+    /// Dane robocze pojedynczego wątku.
+    struct worker_t {
+      track_ids_t args;
+      unordered_map<chart *, count_per_track_t> polls;
+    };
+
+    /** Dzieli przedział [0, count) na spójne części i wywołuje
+     * f(w, początek, koniec) dla każdej z nich w osobnym wątku.
+     * @param[in] count - długość przedziału;
+     * @param[in] workers - liczba części;
+     * @param[in] f - funkcja przetwarzająca część.
+     */
+    template <typename F>
+    void in_parallel(size_t const count, size_t const workers, F f) {
+      vector<std::thread> threads;
+
+      for (size_t w = 1; w < workers; w++)
+        threads.emplace_back(f, w, w * count / workers,
+                             (w + 1) * count / workers);
+      f(0, 0, count / workers);
+
+      for (std::thread &thread: threads)
+        thread.join();
     }
 
-    /** Zwraca ranking siedmiu najlepszych utworów na wyjście standardowe,
-     * według liczby punktów/głosów na poszczególne utwory, zawartych w @p
-     * current_ranking. W rankingu, obok numeru utworu, obliczana jest też
-     * różnica obecnej pozycji względem tej w poprzednim rankingu, określonej w
-     * @p previous_ranking.
-     * @param[in] previous_ranking - siedem najlepszych utworów w poprzednim rankingu
-     * @param[in] current_ranking - siedem najlepszych utworów w obecnym rankingu.
-     * @param[in] current_ordered_ranking - siedem najlepszych utworów w
-     * obecnym rankingu, lecz w strukturze utrzymującej uporządkowanie
-     * malejąco względem liczby punktów/głosów.
+    /// Parametry linii zapisane przez wątek, który ją sparsował.
+    track_span_t arguments(vector<worker_t> const &workers,
+                           parsed_line const &l) {
+      return track_span_t(workers[l.worker].args)
+          .subspan(l.args_begin, l.args_end - l.args_begin);
+    }
+
+    /** Sprawdza i zlicza głosy z linii [begin, end), w których nie ma
+     * poprawnych NEW ani TOP, a następnie dolicza je do list.
      */
-    void print_top7(unordered_ranks_t const &previous_ranking,
-                    unordered_ranks_t const &current_ranking,
-                    ordered_ranks_t const &current_ordered_ranking) {
-
-      for (auto &pair: current_ordered_ranking) {
-        cout << pair.first << DELIM;
-        if (!previous_ranking.contains(pair.first))
-          cout << RANK_NO_CHANGE;
-        else
-          cout <<
-               previous_ranking.at(pair.first) - current_ranking.at(pair.first);
-        cout << endl;
+    void count_votes(vector<parsed_line> &lines, size_t const begin,
+                     size_t const end, vector<worker_t> &workers) {
+      size_t const used =
+          end - begin < MIN_PARALLEL_LINES ? 1 : workers.size();
+
+      in_parallel(end - begin, used,
+                  [&](size_t const w, size_t const from, size_t const to) {
+        worker_t &worker = workers[w];
+        for (size_t i = begin + from; i < begin + to; i++) {
+          parsed_line &l = lines[i];
+          if (!l.valid || l.cmd != Vote)
+            continue;
+
+          track_span_t const ids = arguments(workers, l);
+          l.valid = l.target->check_vote(ids);
+          if (l.valid) {
+            count_per_track_t &poll = worker.polls[l.target];
+            for (track_id_t const id: ids)
+              poll[id]++;
+          }
+        }
+      });
+
+      for (worker_t &worker: workers) {
+        for (auto const &[target, poll]: worker.polls)
+          target->add_votes(poll);
+        worker.polls.clear();
       }
     }
 
-    /** Funkcja przyznaje punkty siedmiu pierwszym utworom na podstawie ich
-     * pozycji.
-     * @param[in] points - mapa z generalną klasyfikacją punktową;
-     * @param[in] listing - nowe notowanie, zawierające siedem najlepszych
-     * utworów.
+    /** Wykonuje blok linii.
+     * @param[in, out] lines - linie bloku;
+     * @param[in, out] charts - listy przebojów;
+     * @param[in] options - opcje wywołania;
+     * @param[in, out] workers - dane robocze wątków;
+     * @param[in] first_num - numer pierwszej linii bloku.
      */
-    void grant_points(count_per_track_t &points,
-                      unordered_ranks_t const &listing) {
+    void run_batch(vector<parsed_line> &lines, charts_t &charts,
+                   options_t const &options, vector<worker_t> &workers,
+                   line_num_t const first_num) {
+
+      in_parallel(lines.size(), workers.size(),
+                  [&](size_t const w, size_t const from, size_t const to) {
+        track_ids_t &args = workers[w].args;
+        args.clear();
+        for (size_t i = from; i < to; i++) {
+          parsed_line &l = lines[i];
+          line_t body = l.line;
+
+          l.worker = w;
+          l.args_begin = args.size();
+          l.routed = options.routing &&
+                     IO::scan_chart(body, l.name, l.top_count);
+          l.parsed = (!options.routing || l.routed) &&
+                     parse_line(l.cmd, body, args);
+          l.valid = l.parsed;
+          l.args_end = args.size();
+        }
+      });
+
+      for (parsed_line &l: lines) {
+        if (l.valid || l.routed) {
+          l.target = find_chart(charts, options.routing ? l.name : "",
+                                options.routing ? l.top_count : 0,
+                                options.top_count, options.window);
+          l.valid = l.valid && l.target != nullptr;
+        }
+      }
 
-      for (const pair<const int, track_rank_t> &pair: listing)
-        points[pair.first] += TOP_COUNT + 1 - pair.second;
+      for (size_t begin = 0; begin < lines.size();) {
+        size_t end = begin;
+        while (end < lines.size() && !(lines[end].valid &&
+               (lines[end].cmd == New || lines[end].cmd == Top)))
+          end++;
+
+        count_votes(lines, begin, end, workers);
+        for (size_t i = begin; i < end; i++) {
+          parsed_line const &l = lines[i];
+          if (!l.valid)
+            error_write(first_num + i, l.line);
+          if (collect_stats)
+            stats::count_line(l.target, l.parsed, l.cmd,
+                              arguments(workers, l), l.valid);
+        }
+
+        if (end < lines.size()) {
+          parsed_line const &l = lines[end];
+          track_span_t const args = arguments(workers, l);
+          bool const valid = l.target->run(l.cmd, args);
+          if (!valid)
+            error_write(first_num + end, l.line);
+          if (collect_stats)
+            stats::count_line(l.target, true, l.cmd, args, valid);
+        }
+        begin = end + 1;
+      }
     }
-  }
 
-  /// Główne funkcje hit_list, odpalane z run().
-  namespace hit_list::run {
-
-    /** Wykonuje NEW MAX.
-     * @param[in, out] previous - poprzednie notowanie;
-     * @param[in, out] dropped - utwory, które wypadły z głosowania;
-     * @param[in, out] poll - głosy w obecnym notowaniu;
-     * @param[in, out] ranking - obecny ranking punktów;
-     * @param[in] max - nowy MAX w NEW MAX.
-     * @return Wartość true, jeżeli dane są poprawne, wartość false w
-     * przeciwnym razie. (Niepoprawne, jeżeli nowy max < stary max).
+    /** Przetwarza całe wejście blokami linii.
+     * @param[in, out] reader - źródło linii;
+     * @param[in, out] charts - listy przebojów;
+     * @param[in] options - opcje wywołania.
+     * @return Liczba przetworzonych linii.
      */
-    bool run_new(unordered_ranks_t &previous_listing,
-                 dropped_tracks_t &dropped,
-                 count_per_track_t &poll, count_per_track_t &ranking,
-                 track_id_t const &max) {
-
-      using namespace list;
-      using top::fetch_ranking;
-      using top::print_top7;
-      using top::grant_points;
-
-      if (max >= previous_listing[MAX_VOTE_ID]) {
-        unordered_ranks_t current_listing;
-        ordered_ranks_t listing_order;
-
-        tie(current_listing, listing_order) = fetch_ranking(poll);
-        grant_points(ranking, current_listing);
-        print_top7(previous_listing, current_listing, listing_order);
-        drop_tracks(previous_listing, current_listing, dropped);
-
-        initialize_listing(previous_listing, current_listing, poll, max);
-        return true;
+    line_num_t run(IO::line_reader &reader, charts_t &charts,
+                   options_t const &options) {
+      vector<worker_t> workers(options.threads);
+      vector<parsed_line> lines;
+      line_num_t line_num = 1, saved = 1, flushed = 1;
+      line_t line;
+
+      while (reader.next(line)) {
+        lines.clear();
+        lines.push_back({line});
+        while (lines.size() < BATCH_LINES && reader.next_buffered(line))
+          lines.push_back({line});
+
+        run_batch(lines, charts, options, workers, line_num);
+        line_num += lines.size();
+        periodic_save(charts, options, saved, line_num);
+        periodic_flush(options, flushed, line_num);
+        stats::report_if_requested(charts);
       }
+      return line_num - 1;
+    }
+  }
+
+  /** Binarny dziennik głosów. Każdej linii wejścia tekstowego odpowiada
+   * jeden rekord, więc numery linii w komunikatach o błędach się nie
+   * zmieniają. Dziennik zaczyna się napisem MAGIC i bajtem flag, a rekord
+   * składa się z:
+   * - bajtu z rodzajem polecenia (cmd_t albo INVALID) i flagami CHART, RAW;
+   * - przy CHART: numeru przedrostka listy w tablicy przedrostków; numer
+   *   równy rozmiarowi tablicy dopisuje do niej nowy przedrostek, podany
+   *   zaraz po numerze jako długość nazwy, nazwa i liczba utworów K;
+   * - przy głosach: liczby utworów i różnic kolejnych numerów utworów
+   *   (pierwszego względem zera) w kodowaniu zigzag;
+   * - przy NEW: nowego MAX;
+   * - przy RAW: długości i treści oryginalnej linii.
+   * Liczby są zapisywane jako varint (po 7 bitów, od najmniej znaczących).
+   * Oryginalna linia jest zapisywana tylko dla linii niepoprawnych i tych,
+   * które różnią się od postaci kanonicznej odtwarzanej z rekordu; jest
+   * potrzebna jedynie do komunikatu o błędzie.
+   */
+  namespace binlog {
+
+    string_view const MAGIC("TOP7LOG1");
+
+    /// Flaga dziennika: linie mogą zaczynać się przedrostkiem listy.
+    uint8_t const ROUTING = 1;
+
+    /// Rodzaj rekordu linii niepoprawnej składniowo.
+    uint8_t const INVALID = 4;
+    /// Maska rodzaju rekordu i flagi rekordu.
+    uint8_t const KIND_MASK = 7;
+    uint8_t const CHART = 8;
+    uint8_t const RAW = 16;
+
+    /// Dopisuje liczbę w kodowaniu varint.
+    void put_varint(string &out, uint64_t value) {
+      while (value >= 0x80) {
+        out += (char) ((value & 0x7f) | 0x80);
+        value >>= 7;
+      }
+      out += (char) value;
+    }
 
+    /** Odczytuje liczbę w kodowaniu varint.
+     * @param[in, out] in - dziennik, po wykonaniu funkcji obcięty o liczbę;
+     * @param[out] value - odczytana liczba.
+     * @return Wartość false, jeżeli w dzienniku zabrakło danych albo liczba
+     * jest za długa, true w przeciwnym razie.
+     */
+    bool get_varint(string_view &in, uint64_t &value) {
+      value = 0;
+      for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (in.empty())
+          return false;
+        uint8_t const byte = in.front();
+        in.remove_prefix(1);
+        value |= (uint64_t) (byte & 0x7f) << shift;
+        if (byte < 0x80)
+          return true;
+      }
       return false;
     }
 
-    /** Wykonuje głosy.
-     * @param[in] poll - aktualne głosy w obecnym notowaniu;
-     * @param[in, out] dropped - utwory, które wypadły z głosowania;
-     * @param[in] line - utwory, na które zagłosowano;
-     * @param[in] max - maksymalny indeks utworu do zagłosowania.
-     * @return Wartość true, jeżeli dane są poprawne, wartość false w
-     * przeciwnym razie.
+    uint64_t zigzag(int64_t const value) {
+      return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+    }
+
+    int64_t unzigzag(uint64_t const value) {
+      return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+    }
+
+    /// Przedrostek listy: nazwa i liczba utworów K (0, jeżeli nie podano).
+    using prefix_t = pair<string, track_rank_t>;
+
+    /** Odtwarza postać kanoniczną linii: przedrostek i polecenie oddzielone
+     * pojedynczymi spacjami.
+     * @param[in] prefix - przedrostek listy albo nullptr;
+     * @param[in] cmd - polecenie;
+     * @param[in] args - parametry polecenia.
+     * @return Linia w postaci kanonicznej.
      */
-    bool run_vote(count_per_track_t &poll,
-                  dropped_tracks_t const &dropped,
-                  string const &line, int const &max) {
+    string canonical_line(prefix_t const *prefix, cmd_t const cmd,
+                          track_span_t const args) {
+      using namespace IO;
+      string line;
+
+      if (prefix) {
+        line += CHART_MARK + prefix->first;
+        if (prefix->second)
+          line += TOP_COUNT_MARK + std::to_string(prefix->second);
+        if (cmd != Empty)
+          line += DELIM;
+      }
+      if (cmd == New)
+        line += string(NEW) + DELIM;
+      else if (cmd == Top)
+        line += TOP;
+      for (size_t i = 0; i < args.size(); i++) {
+        if (i > 0)
+          line += DELIM;
+        line += std::to_string(args[i]);
+      }
+      return line;
+    }
 
-      using namespace poll;
-      vote_set_t vote_set;
+    /// Zapisuje linie wejścia tekstowego jako rekordy dziennika.
+    class writer {
+    public:
+      writer(ostream &out, bool const routing) : out(out) {
+        buffer += MAGIC;
+        buffer += (char) (routing ? ROUTING : 0);
+      }
 
-      if (fetch_votes(vote_set, dropped, line, max))
-        update_poll(poll, vote_set);
-      else
-        return false;
+      /** Dopisuje rekord linii.
+       * @param[in] line - oryginalna linia;
+       * @param[in] valid - czy linia jest poprawna składniowo;
+       * @param[in] prefix - poprawny przedrostek listy albo nullptr. Linia
+       * niepoprawna z poprawnym przedrostkiem też tworzy listę;
+       * @param[in] cmd - polecenie;
+       * @param[in] args - parametry polecenia.
+       */
+      void add(line_t const line, bool const valid, prefix_t const *prefix,
+               cmd_t const cmd, track_span_t const args) {
+        if (!valid) {
+          buffer += (char) (INVALID | RAW | (prefix ? CHART : 0));
+          if (prefix)
+            put_prefix(*prefix);
+          put_raw(line);
+        } else {
+          bool const raw = line != canonical_line(prefix, cmd, args);
+          buffer += (char) (cmd | (prefix ? CHART : 0) | (raw ? RAW : 0));
+          if (prefix)
+            put_prefix(*prefix);
+          put_arguments(cmd, args);
+          if (raw)
+            put_raw(line);
+        }
+
+        if (buffer.size() >= IO::OUTPUT_BUFFER_SIZE)
+          flush();
+      }
 
-      return true;
+      /// Zapisuje zawartość bufora.
+      bool flush() {
+        out.write(buffer.data(), buffer.size());
+        buffer.clear();
+        return (bool) out;
+      }
+
+    private:
+      ostream &out;
+      string buffer;
+      std::map<prefix_t, size_t> prefixes;
+
+      void put_prefix(prefix_t const &prefix) {
+        auto const [it, added] = prefixes.try_emplace(prefix,
+                                                      prefixes.size());
+        put_varint(buffer, it->second);
+        if (added) {
+          put_varint(buffer, prefix.first.length());
+          buffer += prefix.first;
+          put_varint(buffer, prefix.second);
+        }
+      }
+
+      void put_arguments(cmd_t const cmd, track_span_t const args) {
+        track_id_t previous = 0;
+
+        if (cmd == Vote) {
+          put_varint(buffer, args.size());
+          for (track_id_t const id: args) {
+            put_varint(buffer, zigzag((int64_t) id - previous));
+            previous = id;
+          }
+        } else if (cmd == New) {
+          put_varint(buffer, args.front());
+        }
+      }
+
+      void put_raw(line_t const line) {
+        put_varint(buffer, line.length());
+        buffer += line;
+      }
+    };
+
+    /** Zamienia wejście tekstowe na dziennik binarny, nie wykonując
+     * poleceń.
+     * @param[in, out] reader - źródło linii;
+     * @param[in] options - opcje wywołania.
+     * @return Wartość true, jeżeli zapis się powiódł, false w przeciwnym
+     * razie.
+     */
+    bool convert(IO::line_reader &reader, options_t const &options) {
+      ofstream file(options.log_path, std::ios::binary);
+      writer log(file, options.routing);
+      track_ids_t args;
+      prefix_t prefix;
+      line_t line;
+
+      while (reader.next(line)) {
+        line_t body = line;
+        string_view name;
+        track_rank_t top_count = 0;
+        cmd_t cmd = Empty;
+
+        args.clear();
+        bool const routed = options.routing &&
+                            IO::scan_chart(body, name, top_count);
+        bool const valid = (!options.routing || routed) &&
+                           parse_line(cmd, body, args);
+        if (routed && !name.empty()) {
+          prefix.first = name;
+          prefix.second = top_count;
+        }
+        log.add(line, valid, routed && !name.empty() ? &prefix : nullptr,
+                cmd, args);
+      }
+      return log.flush();
     }
 
-    /**
-     * Wykonuje polecenie TOP. Aktualizuje ranking ogólny i umieszcza
-     * go na STDOUT. Zastępuje @p previous_overall zaktualizowanym rankingiem.
-     * @param[in] points - struktura przechowująca łączną liczbę zdobytych
-     * punktów dla każdego utworu;
-     * @param[in,out] previous_overall - struktura przechowująca pozycje siedmiu
-     * najlepszych utworów w poprzednim rankingu ogólnym;
-     * @return
+    /** Odczytuje rekord dziennika.
+     * @param[in, out] in - dziennik, po wykonaniu funkcji obcięty o rekord;
+     * @param[in, out] prefixes - tablica przedrostków list;
+     * @param[out] kind - rodzaj rekordu;
+     * @param[out] prefix - przedrostek listy albo nullptr;
+     * @param[out] args - parametry polecenia;
+     * @param[out] raw - oryginalna linia albo pusty napis, jeżeli linia
+     * jest w postaci kanonicznej.
+     * @return Wartość true, jeżeli rekord jest poprawny, false w przeciwnym
+     * razie.
      */
-    bool run_top(count_per_track_t const &points,
-                 unordered_ranks_t &previous_overall) {
+    bool read_record(string_view &in, vector<prefix_t> &prefixes,
+                     uint8_t &kind, prefix_t const *&prefix,
+                     track_ids_t &args, string_view &raw) {
+      uint8_t const tag = in.front();
+      uint64_t value, count;
+
+      in.remove_prefix(1);
+      kind = tag & KIND_MASK;
+      prefix = nullptr;
+      raw = string_view();
+      args.clear();
+      if (kind > INVALID)
+        return false;
 
-      pair<unordered_ranks_t, ordered_ranks_t> ranking_pair = top::fetch_ranking
-          (points);
-      top::print_top7(previous_overall,
-                      ranking_pair.first, ranking_pair.second);
+      if (tag & CHART) {
+        if (!get_varint(in, value) || value > prefixes.size())
+          return false;
+        if (value == prefixes.size()) {
+          uint64_t length, top_count;
+          if (!get_varint(in, length) || length > in.length())
+            return false;
+          string name(in.substr(0, length));
+          in.remove_prefix(length);
+          if (!get_varint(in, top_count) || top_count > INT32_MAX)
+            return false;
+          prefixes.emplace_back(std::move(name), top_count);
+        }
+        prefix = &prefixes[value];
+      }
 
-      previous_overall.swap(ranking_pair.first);
+      if (kind == Vote) {
+        int64_t id = 0;
+        if (!get_varint(in, count) || count > in.length())
+          return false;
+        for (uint64_t i = 0; i < count; i++) {
+          if (!get_varint(in, value))
+            return false;
+          // Różnica z uszkodzonego dziennika może być dowolna, więc jest
+          // porównywana z odległościami id od końców przedziału, a nie
+          // dodawana, zanim wiadomo, że wynik się w nim mieści.
+          int64_t const delta = unzigzag(value);
+          if (delta < 1 - id || delta > INT32_MAX - id)
+            return false;
+          id += delta;
+          args.push_back(id);
+        }
+      } else if (kind == New) {
+        if (!get_varint(in, value) || value > INT32_MAX)
+          return false;
+        args.push_back(value);
+      }
+
+      if (tag & RAW) {
+        if (!get_varint(in, value) || value > in.length())
+          return false;
+        raw = in.substr(0, value);
+        in.remove_prefix(value);
+      }
       return true;
     }
-  }
 
-  /** Wypisuje komunikat o błędzie w linii na wejściu diagnostycznym.
-   * @param[in] num - numer linii;
-   * @param[in] line - linia na której jest błąd.
-   */
-  void error_write(line_num_t const &num, line_t const &line) {
-    cerr << "Error in line " << num << ": " << line << endl;
+    /** Wykonuje polecenia z dziennika binarnego.
+     * @param[in, out] reader - źródło dziennika;
+     * @param[in, out] charts - listy przebojów;
+     * @param[in] options - opcje wywołania.
+     * @return Liczba przetworzonych rekordów. Jeżeli dziennik jest
+     * uszkodzony, wypisywany jest komunikat o błędzie, a wykonanie kończy się
+     * na ostatnim poprawnym rekordzie.
+     */
+    line_num_t replay(IO::line_reader &reader, charts_t &charts,
+                      options_t const &options) {
+      string_view in = reader.rest();
+      line_num_t line_num = 0, saved = 0, flushed = 0;
+      vector<prefix_t> prefixes;
+      track_ids_t args;
+
+      if (!in.starts_with(MAGIC) || in.length() == MAGIC.length()) {
+        report_failure("Invalid log ", options.path ? options.path : "-");
+        return 0;
+      }
+      in.remove_prefix(MAGIC.length() + 1);
+
+      while (!in.empty()) {
+        uint8_t kind;
+        prefix_t const *prefix;
+        string_view raw;
+
+        chart *target = nullptr;
+        {
+          stats::timer const t(stats::Parse);
+          if (!read_record(in, prefixes, kind, prefix, args, raw)) {
+            report_failure("Invalid log ", options.path ? options.path : "-");
+            break;
+          }
+          line_num++;
+
+          if (kind != INVALID || prefix)
+            target = find_chart(charts, prefix ? prefix->first : "",
+                                prefix ? prefix->second : 0,
+                                options.top_count, options.window);
+        }
+        bool const parsed = kind != INVALID && target;
+        bool const valid = parsed && target->run((cmd_t) kind, args);
+        if (!valid) {
+          if (raw.empty() && kind != INVALID)
+            error_write(line_num, canonical_line(prefix, (cmd_t) kind, args));
+          else
+            error_write(line_num, raw);
+        }
+        if (collect_stats)
+          stats::count_line(target, parsed, (cmd_t) kind, args, valid);
+        periodic_save(charts, options, saved, line_num);
+        periodic_flush(options, flushed, line_num);
+        stats::report_if_requested(charts);
+      }
+      return line_num;
+    }
   }
 
-  /** Oczyszcza linię wejścia ze zbędnych danych, rozpoznaje polecenie, a
-   * także sprawdza jej poprawność. Dane są oddzielone napisem DELIM.
-   * @param[in, out] line - skanowany napis;
-   * @param[in, out] cmd - rodzaj polecenia.
-   * @return Wartość true, jeżeli dane są poprawne; wartość false w
-   * przeciwnym razie.
+  /** Odczytuje opcje wywołania programu.
+   * @param[in] argc, argv - argumenty wywołania;
+   * @param[out] options - odczytane opcje.
+   * @return True, jeżeli opcje są poprawne, false w przeciwnym razie.
    */
-  bool parse_line(cmd_t &cmd, line_t &line) {
-    using namespace IO;
-    trim_spaces(line);
-    cmd = parse_command(line);
-    return validate_parameters(line, cmd);
-  }
+  bool parse_options(int argc, char *argv[], options_t &options) {
+    for (int i = 1; i < argc; i++) {
+      string_view const arg(argv[i]);
+      size_t pos = 0;
+
+      if (arg == "-c") {
+        options.routing = true;
+      } else if (arg == "-l") {
+        options.line_buffered = true;
+      } else if (arg == "-b") {
+        options.benchmark = true;
+      } else if (arg == "-r") {
+        options.binary = true;
+      } else if (arg == "-w" && i + 1 < argc) {
+        options.log_path = argv[++i];
+      } else if ((arg == "-k" || arg == "-j" || arg == "-p" || arg == "-f" ||
+                  arg == "-W") && i + 1 < argc) {
+        string_view const value(argv[++i]);
+        track_id_t number;
+        if (!IO::scan_number(value, pos, number) || pos != value.length())
+          return false;
 
-  /** Uruchamia listę przebojów. Jeżeli kończy działanie wartością false,
-   * to nie zachodzą żadne zmiany w strukturach danych.
-   * @param[in] cmd - typ polecenia;
-   * @param[in] line - parametry polecenia.
-   * @return Wartość true, jeżeli dane są poprawne, false w przeciwnym razie.
-   */
-  bool run(hit_list_t &data, cmd_t const &cmd, line_t const &line) {
-    using namespace hit_list::run;
-    switch (cmd) {
-      case New:
-        return run_new(get<PREVIOUS_LISTING>(data), get<DROPPED>(data),
-                       get<POLL>(data), get<POINTS>(data), stoi(line));
-      case Vote:
-        return run_vote(get<POLL>(data), get<DROPPED>(data),
-                        line, get<PREVIOUS_LISTING>(data)[MAX_VOTE_ID]);
-      case Top:
-        return run_top(get<POINTS>(data),
-                       get<PREVIOUS_OVERALL>(data));
-      default:
-        return true; // tu będzie Empty
+        if (arg == "-k")
+          options.top_count = number;
+        else if (arg == "-j")
+          options.threads = number;
+        else if (arg == "-p")
+          options.save_every = number;
+        else if (arg == "-W")
+          options.window = number;
+        else
+          options.flush_every = number;
+      } else if (arg == "-s" && i + 1 < argc) {
+        options.state_path = argv[++i];
+      } else if (!options.path && !arg.empty() && arg.front() != '-') {
+        options.path = argv[i];
+      } else {
+        return false;
+      }
     }
+    return (!options.save_every || options.state_path) &&
+           !(options.binary && options.log_path);
   }
 }
 
-int main() {
-  line_num_t line_num = 0;
+/** Uruchomienie:
+ * top7 [-c] [-l] [-f N] [-b] [-k K] [-W N] [-j N] [-s STAN [-p N]]
+ * [-r | -w DZIENNIK] [PLIK].
+ * Jeżeli podano PLIK, głosy są czytane z odwzorowanego w pamięci pliku,
+ * a w przeciwnym razie ze standardowego wejścia. Opcja -k ustala liczbę
+ * utworów w notowaniu (domyślnie 7). Opcja -W sprawia, że do podsumowań
+ * liczą się tylko punkty z ostatnich N notowań. Opcja -c pozwala prowadzić
+ * wiele list przebojów naraz: linia zaczynająca się od "@nazwa" albo
+ * "@nazwa:K" trafia do listy o tej nazwie, a jej notowania są poprzedzone
+ * tym samym przedrostkiem. Opcja -j przetwarza głosy w N wątkach. Opcja -s odtwarza
+ * stan list przebojów z pliku STAN przed przetworzeniem wejścia (jeżeli
+ * plik istnieje) i zapisuje go tam po przetworzeniu, a opcja -p dodatkowo
+ * zapisuje stan co N linii wejścia. Wyjście jest buforowane i opróżniane
+ * na końcu działania programu; opcja -f opróżnia je dodatkowo co N linii
+ * wejścia, a opcja -l (domyślna, gdy wyjście jest terminalem) po każdej
+ * linii wyjścia. Opcja -b wypisuje na końcu na wyjście diagnostyczne liczbę
+ * linii przetwarzanych na sekundę, a przy przetwarzaniu w jednym wątku także
+ * percentyle czasów wykonania głosowania, NEW i TOP, pamięć zajmowaną przez
+ * listy, przepustowość tych samych poleceń wykonanych ponownie
+ * bezpośrednio na silniku z top7.h oraz czas parsowania próbki linii
+ * skanerem i, dla porównania, wyrażeniami regularnymi.
+ * Opcja -w zamienia wejście tekstowe na binarny DZIENNIK (patrz binlog), nie
+ * wykonując poleceń, a opcja -r wykonuje polecenia z takiego dziennika
+ * podanego jako wejście, w jednym wątku. Wynik jest taki sam jak dla
+ * wejścia tekstowego, z którego powstał dziennik.
+ * Program skompilowany z -DTOP7_STATS wypisuje na wyjście diagnostyczne
+ * statystyki przetwarzania (patrz stats) na końcu działania i po każdym
+ * sygnale SIGUSR1.
+ */
+int main(int argc, char *argv[]) {
+  using IO::line_reader;
+
+  options_t options;
+  if (!parse_options(argc, argv, options)) {
+    IO::err << "Usage: " << argv[0]
+            << " [-c] [-l] [-f N] [-b] [-k K] [-W N] [-j N] [-s STATE [-p N]]"
+            << " [-r | -w LOG] [FILE]";
+    IO::err.end_line();
+    return 1;
+  }
+
+  bool const interactive = options.line_buffered || isatty(STDOUT_FILENO);
+  IO::out.set_line_buffered(interactive);
+  IO::err.set_line_buffered(interactive);
+
+  line_num_t line_num = 0, saved = 0, flushed = 0;
   cmd_t cmd;
   line_t line;
-  hit_list_t data = make_tuple(count_per_track_t(), unordered_ranks_t(),
-                               dropped_tracks_t(), unordered_ranks_t(),
-                               count_per_track_t());
+  track_ids_t args;
+  charts_t charts;
+  if (options.state_path &&
+      !load_charts(charts, options.state_path, options.top_count)) {
+    report_failure("Cannot load ", options.state_path);
+    return 1;
+  }
+  chart &main_chart =
+      charts.try_emplace("", "", options.top_count, options.window)
+          .first->second;
+
+  line_reader reader = options.path ? line_reader(options.path)
+                                    : line_reader(STDIN_FILENO);
+  if (!reader.is_open()) {
+    report_failure("Cannot open ", options.path);
+    return 1;
+  }
 
-  get<PREVIOUS_LISTING>(data).insert({MAX_VOTE_ID, 0}); // MAX=0 przed notowaniem.
+  if (options.log_path) {
+    if (binlog::convert(reader, options))
+      return 0;
+    report_failure("Cannot write ", options.log_path);
+    return 1;
+  }
 
-  while (getline(cin, line)) {
-    line_num++;
-    line_t line_orig(line);
+  if (collect_stats)
+    std::signal(SIGUSR1, stats::request_report);
+
+  bench::recorder recorder;
+  bench::replay replay;
+  bench::parse_compare parsing;
+  if (options.binary) {
+    line_num = binlog::replay(reader, charts, options);
+  } else if (options.threads > 1) {
+    line_num = batch::run(reader, charts, options);
+  } else {
+    while (reader.next(line)) {
+      line_num++;
+      line_t body = line;
+      chart *target;
+      bool parsed;
+      {
+        stats::timer const t(stats::Parse);
+        target = options.routing ? select_chart(charts, body,
+                                                options.top_count,
+                                                options.window)
+                                 : &main_chart;
+        args.clear();
+        parsed = target && parse_line(cmd, body, args);
+      }
+      if (options.benchmark && target)
+        parsing.add(body);
+      bool valid = parsed;
+      if (valid) {
+        bench::clock_t::time_point const start =
+            options.benchmark ? bench::clock_t::now()
+                              : bench::clock_t::time_point();
+        valid = target->run(cmd, args);
+        if (options.benchmark) {
+          recorder.record(cmd, start);
+          replay.add(target, cmd, args);
+        }
+      }
+      if (!valid)
+        error_write(line_num, line);
+      if (collect_stats)
+        stats::count_line(target, parsed, cmd, args, valid);
+      periodic_save(charts, options, saved, line_num);
+      periodic_flush(options, flushed, line_num);
+      stats::report_if_requested(charts);
+    }
+  }
 
-    if (!parse_line(cmd, line) || !run(data, cmd, line))
-      error_write(line_num, line_orig);
+  if (options.state_path && !save_charts(charts, options.state_path)) {
+    report_failure("Cannot save ", options.state_path);
+    return 1;
+  }
+  if (options.benchmark) {
+    recorder.report(line_num);
+    bench::report_memory(charts);
+    replay.report();
+    parsing.report();
   }
+  if (collect_stats)
+    stats::report(charts);
   return 0;
 }
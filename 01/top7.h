@@ -0,0 +1,1280 @@
+#ifndef TOP7_H
+#define TOP7_H
+
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <array>
+#include <span>
+#include <tuple>
+#include <unordered_set>
+#include <unordered_map>
+#include <algorithm>
+
+/** Silnik list przebojów: głosowania, notowania i podsumowania na
+ * sparsowanych już numerach utworów, bez formatu tekstowego wejścia
+ * i wyjścia. Program top7 jest nakładką tekstową na ten silnik.
+ */
+namespace top7 {
+
+  /// Wejście, wyjście
+  using std::string, std::string_view, std::ostream;
+
+  /// Struktury danych.
+  using std::vector, std::array, std::unordered_map, std::unordered_set,
+        std::pair, std::tuple, std::span, std::conditional_t, std::get;
+
+  /// Narzędzia
+  using std::find_if, std::adjacent_find, std::sort, std::copy,
+        std::iter_swap, std::prev, std::min;
+
+  /// Kompilowanie z parametrem -DTOP7_DENSE wybiera liczniki głosów i zbiór
+  /// utworów, które wypadły, przechowywane w tablicach indeksowanych numerem
+  /// utworu zamiast w tablicach haszujących.
+#ifdef TOP7_DENSE
+  bool const dense_storage = true;
+#else
+  bool const dense_storage = false;
+#endif
+
+  /// Zbiór utworów.
+  using track_id_t = int_least32_t;
+  using track_set_t = unordered_set<track_id_t>;
+
+  /// Liczby odczytane z linii: numery utworów albo nowy MAX.
+  using track_ids_t = vector<track_id_t>;
+  using track_span_t = span<track_id_t const>;
+
+  /** Notowanie (podsumowanie) utworów.
+   * $1 - numer utworu;
+   * $2 - ilość głosów (punktów) zdobyta przez ten utwór.
+   */
+  using count_t = size_t;
+  using count_per_track_t = unordered_map<track_id_t, count_t>;
+
+  /** Rozkład miejsc w poprzednim notowaniu (podsumowaniu) utworów.
+   * $1 - numer utworu;
+   * $2 - pozycja w poprzednim new7 (top7).
+   */
+  using track_rank_t = int_least32_t;
+  using unordered_ranks_t = unordered_map<track_id_t, track_rank_t>;
+
+  /// Posortowane przeboje. Rozmiar niekoniecznie musi być 7. Wartością są punkty.
+  using top7_pair = pair<track_id_t, count_t>;
+  using top7_t = vector<top7_pair>;
+
+  /// Utwór w notowaniu (podsumowaniu) zwracanym przez chart.
+  struct ranked_track {
+    /// Numer utworu.
+    track_id_t id;
+    /// Liczba głosów (punktów) utworu.
+    count_t count;
+    /// Pozycja, licząc od 1.
+    track_rank_t rank;
+    /// Pozycja w poprzednim notowaniu (podsumowaniu) albo 0, jeżeli utworu
+    /// w nim nie było.
+    track_rank_t previous_rank;
+  };
+
+  /// Notowanie (podsumowanie) uporządkowane według pozycji.
+  using ranking_t = vector<ranked_track>;
+
+  /// Przybliżona pamięć zajmowana przez listę przebojów, w bajtach.
+  struct memory_t {
+    /// Liczba utworów z punktami i pamięć tablicy punktów.
+    size_t points_tracks, points_bytes;
+    /// Liczba utworów, które wypadły, i pamięć ich zbioru.
+    size_t dropped_tracks, dropped_bytes;
+    /// Pamięć głosów w bieżącym notowaniu i okna notowań.
+    size_t poll_bytes, window_bytes;
+    /// Liczba liczników punktów usuniętych dotąd przez kompaktowanie.
+    size_t compacted_tracks;
+    /// Liczba kubełków tablicy punktów.
+    size_t points_buckets;
+    /// Liczba utworów z głosami w bieżącym notowaniu i liczba kubełków
+    /// tablicy głosów (0, jeżeli głosy nie są w tablicy haszującej).
+    size_t poll_tracks, poll_buckets;
+  };
+
+  /// Wynik sprawdzenia głosów z jednej linii.
+  enum vote_error_t {
+    /// Głosy są poprawne.
+    VoteValid,
+    /// Numer utworu spoza przedziału [1, MAX].
+    VoteOutOfRange,
+    /// Głos na utwór, który wypadł.
+    VoteDropped,
+    /// Powtórzony głos na ten sam utwór.
+    VoteRepeated
+  };
+
+  /// Domyślna liczba przebojów pojedynczego notowania (podsumowania).
+  track_rank_t const DEFAULT_TOP_COUNT = 7;
+
+  /** Przechowywane struktury danych.
+   * $0 - zebrane punkty przez poszczególne utwory;
+   * $1 - rozkład miejsc w poprzednim podsumowaniu;
+   * $2 - zbiór utworów, które wypadły z losowania;
+   * $3 - rozkład miejsc w poprzednim notowaniu;
+   * $4 - wektor zbiorów głosów zebranych w pojedynczych liniach;
+   * $5 - punkty przyznane w ostatnich notowaniach.
+   */
+  int const POINTS = 0;
+  int const PREVIOUS_OVERALL = 1;
+  int const DROPPED = 2;
+  int const PREVIOUS_LISTING = 3;
+  int const POLL = 4;
+  int const WINDOW = 5;
+
+  /// Liczniki głosów i punktów oraz zbiory utworów.
+  namespace hit_list::counts {
+
+    /**
+     * Porównuje punktację dwóch utworów.
+     * @param a - para zawierająca numer pierwszego utworu oraz liczbę jego
+     * punktów.
+     * @param b - para zawierająca numer drugiego utworu oraz liczbę jego
+     * punktów.
+     * @return @p true, jeśli pierwszy utwór jest wyżej w rankingu, @p false
+     * w przeciwnym wypadku.
+     */
+    inline bool compare_points(top7_pair const &a, top7_pair const &b) {
+      if (a.second == b.second)
+        return a.first < b.first;
+      else
+        return a.second > b.second;
+    }
+
+    /** Przybliżona liczba bajtów zajmowanych przez tablicę haszującą:
+     * węzły z elementami i wskaźnikiem na następny węzeł oraz kubełki.
+     */
+    template <typename hashed_t>
+    size_t hashed_memory(hashed_t const &table) {
+      return table.size() * (sizeof(typename hashed_t::value_type) +
+                             sizeof(void *)) +
+             table.bucket_count() * sizeof(void *);
+    }
+
+    /// Najmniejsza liczba nowych utworów, które compact() przenosi do
+    /// przedziałów.
+    size_t const COMPACT_MIN_TRACKS = 1024;
+
+    /// Rozmiar, do którego tablica liczników dense_counts może rosnąć
+    /// niezależnie od liczby utworów z głosami.
+    size_t const DENSE_MIN_TRACKS = 1 << 16;
+
+    /// Ile razy więcej liczników niż utworów z głosami może mieć tablica
+    /// dense_counts. Licznik w tablicy zajmuje 4 bajty, a w tablicy
+    /// haszującej kilkadziesiąt, więc przy takim zapełnieniu tablica nie
+    /// zajmuje więcej pamięci niż tablica haszująca.
+    size_t const DENSE_SPARSITY = 8;
+
+    /** Co najwyżej top_count najlepszych utworów, posortowanych według
+     * compare_points(), uaktualniane przy każdym zwiększeniu licznika.
+     * Liczniki tylko rosną, więc utwór spoza listy może na nią wejść jedynie
+     * w miejsce ostatniego, a utwór z listy może się tylko przesunąć w górę.
+     */
+    class best_tracks {
+    public:
+      explicit best_tracks(track_rank_t const top_count)
+          : top_count(top_count) {}
+
+      /// Uwzględnia nową liczbę głosów (punktów) utworu id.
+      void update(track_id_t const id, count_t const count) {
+        top7_pair const entry{id, count};
+        if (is_full() && best.back().first != id &&
+            !compare_points(entry, best.back()))
+          return;
+
+        auto it = find_if(best.begin(), best.end(),
+                          [id](top7_pair const &p) { return p.first == id; });
+        if (it != best.end()) {
+          it->second = count;
+        } else {
+          if (is_full())
+            best.pop_back();
+          it = best.insert(best.end(), entry);
+        }
+
+        for (; it != best.begin() && compare_points(*it, *prev(it)); it--)
+          iter_swap(it, prev(it));
+      }
+
+      void clear() {
+        best.clear();
+      }
+
+      bool contains(track_id_t const id) const {
+        return find_if(best.begin(), best.end(), [id](top7_pair const &p) {
+          return p.first == id;
+        }) != best.end();
+      }
+
+      top7_t const &ranking() const {
+        return best;
+      }
+
+    private:
+      track_rank_t top_count;
+      top7_t best;
+
+      bool is_full() const {
+        return best.size() == (size_t) top_count;
+      }
+    };
+
+    /** Liczniki głosów (punktów) w tablicy haszującej. Zajmowana pamięć
+     * zależy tylko od liczby utworów, które mają niezerowy licznik.
+     * Zmniejszenie licznika utworu z najlepszych może wpuścić na listę
+     * najlepszych dowolny inny utwór, więc wtedy lista jest odtwarzana
+     * ze wszystkich liczników przy następnym wywołaniu ranking().
+     */
+    class hashed_counts {
+    public:
+      /// @param[in] top_count - liczba utrzymywanych najlepszych utworów.
+      explicit hashed_counts(track_rank_t const top_count)
+          : best(top_count) {}
+
+      /// Dodaje utworowi id n głosów (punktów).
+      void add(track_id_t const id, count_t const n) {
+        best.update(id, counts[id] += n);
+      }
+
+      /// Odejmuje utworowi id n spośród dodanych mu głosów (punktów),
+      /// ale nie więcej niż ma.
+      void subtract(track_id_t const id, count_t const n) {
+        auto const it = counts.find(id);
+        if (it == counts.end())
+          return;
+        if (it->second <= n)
+          counts.erase(it);
+        else
+          it->second -= n;
+        if (best.contains(id))
+          stale = true;
+      }
+
+      /// Przygotowuje liczniki na utwory o numerach nie większych niż max.
+      void grow(track_id_t const) {}
+
+      /// Rezerwuje miejsce na n utworów o niezerowym liczniku.
+      void reserve(size_t const n) {
+        counts.reserve(n);
+      }
+
+      /// Zeruje wszystkie liczniki.
+      void clear() {
+        counts = count_per_track_t();
+        best.clear();
+        stale = false;
+      }
+
+      /// Najlepsze utwory, posortowane malejąco według liczników.
+      top7_t const &ranking() const {
+        if (stale) {
+          best.clear();
+          for (auto const &[id, count]: counts)
+            best.update(id, count);
+          stale = false;
+        }
+        return best.ranking();
+      }
+
+      /// Wywołuje f(id, liczba) dla każdego utworu o niezerowym liczniku.
+      template <typename F>
+      void for_each(F f) const {
+        for (auto const &[id, count]: counts)
+          f(id, count);
+      }
+
+      /// Licznik utworu id.
+      count_t get(track_id_t const id) const {
+        auto const it = counts.find(id);
+        return it == counts.end() ? 0 : it->second;
+      }
+
+      /// Liczba utworów o niezerowym liczniku.
+      size_t size() const {
+        return counts.size();
+      }
+
+      /// Liczba kubełków tablicy liczników.
+      size_t buckets() const {
+        return counts.bucket_count();
+      }
+
+      /// Przybliżona liczba zajmowanych bajtów.
+      size_t memory() const {
+        return hashed_memory(counts);
+      }
+
+      /** Usuwa liczniki utworów spełniających pred(id, liczba), spoza
+       * najlepszych, i zmniejsza tablicę, jeżeli usunięto ich dużo.
+       * @return Liczba usuniętych liczników.
+       */
+      template <typename P>
+      size_t erase_if(P pred) {
+        size_t const erased = std::erase_if(counts, [&pred](auto const &entry) {
+          return pred(entry.first, entry.second);
+        });
+        if (erased > counts.size())
+          counts.rehash(0);
+        return erased;
+      }
+
+    private:
+      count_per_track_t counts;
+      mutable best_tracks best;
+      /// Czy best trzeba odtworzyć po zmniejszeniu licznika.
+      mutable bool stale = false;
+    };
+
+    /** Liczniki głosów w tablicy indeksowanej numerem utworu, powiększanej
+     * przy każdym NEW do bieżącego MAX. Dodanie głosu to inkrementacja
+     * elementu tablicy. Liczniki są 32-bitowe; utwór, którego licznik
+     * przekroczyłby ten zakres, ma do końca notowania licznik w tablicy
+     * haszującej, a w tablicy znacznik SPILLED. Tablica ma najwyżej
+     * DENSE_SPARSITY razy więcej liczników, niż było utworów z głosami w najliczniejszym
+     * dotąd notowaniu (albo DENSE_MIN_TRACKS), więc MAX dużo większy od
+     * liczby utworów, na które się głosuje, nie zajmuje pamięci: utwory
+     * o numerach spoza tablicy mają liczniki w tablicy haszującej. Osobno
+     * pamiętane są utwory o niezerowym liczniku w tablicy, więc zerowanie
+     * i przeglądanie nie zależą od MAX.
+     */
+    class dense_counts {
+    public:
+      explicit dense_counts(track_rank_t const top_count)
+          : best(top_count) {}
+
+      void add(track_id_t const id, count_t const n) {
+        if ((size_t) id >= counts.size()) {
+          best.update(id, sparse[id] += n);
+          return;
+        }
+        dense_count_t &count = counts[id];
+        if (count == 0)
+          touched.push_back(id);
+        if ((count_t) count + n < SPILLED) {
+          best.update(id, count += n);
+          return;
+        }
+        count_t &total = sparse[id];
+        if (count != SPILLED) {
+          total = count;
+          count = SPILLED;
+          spilled++;
+        }
+        best.update(id, total += n);
+      }
+
+      void grow(track_id_t const max) {
+        size_t const limit = std::max(DENSE_MIN_TRACKS, DENSE_SPARSITY * peak);
+        size_t const size = min((size_t) max + 1, limit);
+        if (counts.size() < size)
+          counts.resize(size);
+      }
+
+      void reserve(size_t const n) {
+        touched.reserve(min(n, counts.size()));
+      }
+
+      void clear() {
+        peak = std::max(peak, size());
+        for (track_id_t const id: touched)
+          counts[id] = 0;
+        touched.clear();
+        sparse = count_per_track_t();
+        spilled = 0;
+        best.clear();
+      }
+
+      top7_t const &ranking() const {
+        return best.ranking();
+      }
+
+      template <typename F>
+      void for_each(F f) const {
+        for (track_id_t const id: touched)
+          if (counts[id] != SPILLED)
+            f(id, counts[id]);
+        for (auto const &[id, count]: sparse)
+          f(id, count);
+      }
+
+      size_t size() const {
+        return touched.size() + sparse.size() - spilled;
+      }
+
+      /// Liczba kubełków tablicy haszującej liczników spoza tablicy.
+      size_t buckets() const {
+        return sparse.bucket_count();
+      }
+
+      size_t memory() const {
+        return counts.capacity() * sizeof(dense_count_t) +
+               touched.capacity() * sizeof(track_id_t) +
+               hashed_memory(sparse);
+      }
+
+    private:
+      using dense_count_t = uint32_t;
+
+      /// Znacznik w counts utworu, którego licznik jest w sparse.
+      static dense_count_t const SPILLED = dense_count_t(-1);
+
+      vector<dense_count_t> counts;
+      track_ids_t touched;
+      /// Liczniki utworów o numerach spoza tablicy counts i tych o znaczniku
+      /// SPILLED.
+      count_per_track_t sparse;
+      /// Liczba utworów o znaczniku SPILLED, które są zarówno w touched, jak
+      /// i w sparse.
+      size_t spilled = 0;
+      /// Największa dotąd liczba utworów z głosami w jednym notowaniu.
+      size_t peak = 0;
+      best_tracks best;
+    };
+
+    /** Zbiór utworów jako posortowane, rozłączne przedziały numerów oraz
+     * tablica haszująca z utworami dodanymi od ostatniego compact().
+     * Przedział zajmuje tyle pamięci co dwa numery, niezależnie od liczby
+     * utworów w nim, a sprawdzenie przynależności to wyszukiwanie binarne.
+     */
+    class range_tracks {
+    public:
+      bool contains(track_id_t const id) const {
+        return recent.contains(id) || in_ranges(id);
+      }
+
+      void insert(track_id_t const id) {
+        if (!in_ranges(id) && recent.insert(id).second)
+          count++;
+      }
+
+      /** Przenosi nowe utwory do przedziałów, jeżeli jest ich na tyle dużo,
+       * że koszt przebudowy przedziałów rozkłada się na ich dodanie.
+       */
+      void compact() {
+        if (recent.size() < std::max(COMPACT_MIN_TRACKS, ranges.size() / 4))
+          return;
+
+        track_ids_t added(recent.begin(), recent.end());
+        vector<range_t> merged;
+        auto range = ranges.begin();
+        auto id = added.begin();
+
+        sort(added.begin(), added.end());
+        merged.reserve(ranges.size() + added.size());
+        while (range != ranges.end() || id != added.end()) {
+          range_t const next = id == added.end() ||
+                               (range != ranges.end() && range->first < *id)
+                               ? *range++ : range_t{*id, *id++};
+          if (!merged.empty() && merged.back().second + 1 >= next.first)
+            merged.back().second = std::max(merged.back().second,
+                                            next.second);
+          else
+            merged.push_back(next);
+        }
+
+        merged.shrink_to_fit();
+        ranges.swap(merged);
+        recent = track_set_t();
+      }
+
+      /// Liczba utworów w zbiorze.
+      size_t size() const {
+        return count;
+      }
+
+      /// Przybliżona liczba zajmowanych bajtów.
+      size_t memory() const {
+        return ranges.capacity() * sizeof(range_t) + hashed_memory(recent);
+      }
+
+      /// Wywołuje f(id) dla każdego utworu w zbiorze.
+      template <typename F>
+      void for_each(F f) const {
+        for (auto const &[first, last]: ranges) {
+          for (track_id_t id = first; id <= last; id++)
+            f(id);
+        }
+        for (track_id_t const id: recent)
+          f(id);
+      }
+
+    private:
+      /// Przedział numerów [first, last].
+      using range_t = pair<track_id_t, track_id_t>;
+
+      vector<range_t> ranges;
+      track_set_t recent;
+      size_t count = 0;
+
+      bool in_ranges(track_id_t const id) const {
+        auto const it = std::upper_bound(
+            ranges.begin(), ranges.end(), id,
+            [](track_id_t const id, range_t const &r) { return id < r.first; });
+        return it != ranges.begin() && prev(it)->second >= id;
+      }
+    };
+
+    /** Zbiór utworów jako wektor bitów indeksowany numerem utworu. Wektor
+     * ma najwyżej BITS_PER_TRACK bitów na utwór w zbiorze (albo
+     * DENSE_MIN_TRACKS bitów), czyli tyle, ile zajmuje węzeł tablicy
+     * haszującej, a utwory o większych numerach są w tablicy haszującej.
+     */
+    class dense_tracks {
+    public:
+      bool contains(track_id_t const id) const {
+        return (size_t) id < tracks.size() ? tracks[id] : sparse.contains(id);
+      }
+
+      void insert(track_id_t const id) {
+        if ((size_t) id >= tracks.size())
+          grow(id);
+        if ((size_t) id >= tracks.size()) {
+          if (sparse.insert(id).second)
+            count++;
+        } else if (!tracks[id]) {
+          tracks[id] = true;
+          count++;
+        }
+      }
+
+      /// Wektor bitów nie wymaga kompaktowania.
+      void compact() {}
+
+      size_t size() const {
+        return count;
+      }
+
+      size_t memory() const {
+        return tracks.capacity() / 8 + hashed_memory(sparse);
+      }
+
+      template <typename F>
+      void for_each(F f) const {
+        for (size_t id = 0; id < tracks.size(); id++) {
+          if (tracks[id])
+            f((track_id_t) id);
+        }
+        for (track_id_t const id: sparse)
+          f(id);
+      }
+
+    private:
+      static size_t const BITS_PER_TRACK = 256;
+
+      vector<bool> tracks;
+      /// Utwory o numerach spoza wektora tracks.
+      track_set_t sparse;
+      size_t count = 0;
+
+      /** Powiększa wektor tak, żeby mieścił utwór id, o ile pozwala na to
+       * liczba utworów w zbiorze. Wektor rośnie co najmniej dwukrotnie, a
+       * utwory z tablicy haszującej, które się w nim zmieszczą, są do niego
+       * przenoszone.
+       */
+      void grow(track_id_t const id) {
+        size_t const limit = std::max(DENSE_MIN_TRACKS,
+                                      BITS_PER_TRACK * (count + 1));
+        if ((size_t) id >= limit)
+          return;
+
+        tracks.resize(min(limit, std::max((size_t) id + 1,
+                                          2 * tracks.size())));
+        std::erase_if(sparse, [this](track_id_t const moved) {
+          if ((size_t) moved >= tracks.size())
+            return false;
+          tracks[moved] = true;
+          return true;
+        });
+      }
+    };
+
+    /** Punkty przyznane w ostatnich notowaniach, przechowywane w buforze
+     * cyklicznym po jednym miejscu na notowanie. Zapamiętanie notowania na
+     * miejscu najstarszego odbiera punkty przyznane w tamtym, więc łączne
+     * punkty obejmują tylko ostatnie notowania, a tablica punktów zawiera
+     * co najwyżej tyle utworów, ile zmieści się w tych notowaniach.
+     */
+    class listing_window {
+    public:
+      /// @param[in] size - liczba notowań albo 0, jeżeli punkty nie wygasają.
+      explicit listing_window(size_t const size = 0) : listings(size) {}
+
+      size_t size() const {
+        return listings.size();
+      }
+
+      /// Przybliżona liczba zajmowanych bajtów.
+      size_t memory() const {
+        size_t bytes = listings.capacity() * sizeof(top7_t);
+        for (top7_t const &listing: listings)
+          bytes += listing.capacity() * sizeof(top7_pair);
+        return bytes;
+      }
+
+      /** Zapamiętuje punkty przyznane w nowym notowaniu i odbiera punkty
+       * z notowania, które wypadło z okna.
+       * @param[in, out] points - łączne punkty;
+       * @param[in] listing - nowe notowanie;
+       * @param[in] top_count - liczba utworów w notowaniu.
+       */
+      void add(hashed_counts &points, unordered_ranks_t const &listing,
+               track_rank_t const top_count) {
+        if (listings.empty())
+          return;
+
+        top7_t &oldest = listings[next];
+        for (auto const &[id, n]: oldest)
+          points.subtract(id, n);
+
+        oldest.clear();
+        for (auto const &[id, rank]: listing)
+          oldest.push_back({id, (count_t) (top_count + 1 - rank)});
+        next = (next + 1) % listings.size();
+      }
+
+      /// Wywołuje f(punkty) dla kolejnych notowań, od najstarszego.
+      template <typename F>
+      void for_each(F f) const {
+        for (size_t i = 0; i < listings.size(); i++)
+          f(listings[(next + i) % listings.size()]);
+      }
+
+      /** Sprawdza, czy łączne punkty obejmują punkty z notowań w oknie,
+       * czyli czy add() może je odebrać.
+       * @param[in] points - łączne punkty.
+       */
+      bool covered_by(hashed_counts const &points) const {
+        count_per_track_t sums;
+        for (top7_t const &listing: listings)
+          for (auto const &[id, n]: listing)
+            if ((sums[id] += n) < n)
+              return false;
+        return std::all_of(sums.begin(), sums.end(), [&points](auto const &s) {
+          return s.second <= points.get(s.first);
+        });
+      }
+
+      /// Dopisuje notowanie jako najnowsze bez zmiany łącznych punktów.
+      void restore(top7_t listing) {
+        listings[next] = std::move(listing);
+        next = (next + 1) % listings.size();
+      }
+
+    private:
+      vector<top7_t> listings;
+      /// Miejsce najstarszego notowania.
+      size_t next = 0;
+    };
+  }
+
+  /// Głosy w bieżącym notowaniu.
+  using poll_t = conditional_t<dense_storage, hit_list::counts::dense_counts,
+    hit_list::counts::hashed_counts>;
+
+  /// Łączne punkty utworów. Punkty dostaje tylko kilka utworów na notowanie,
+  /// więc tablica haszująca jest zawsze mniejsza od tablicy indeksowanej.
+  using points_t = hit_list::counts::hashed_counts;
+
+  /// Zbiór utworów, które wypadły z głosowania.
+  using dropped_tracks_t = conditional_t<dense_storage,
+    hit_list::counts::dense_tracks, hit_list::counts::range_tracks>;
+
+  /** Przechowywane struktury danych.
+   * $0 - zebrane punkty przez poszczególne utwory;
+   * $1 - rozkład miejsc w poprzednim podsumowaniu;
+   * $2 - zbiór utworów, które wypadły z losowania;
+   * $3 - rozkład miejsc w poprzednim notowaniu;
+   * $4 - wektor zbiorów głosów zebranych w pojedynczych liniach;
+   * $5 - punkty przyznane w ostatnich notowaniach.
+   */
+  using hit_list_t = tuple<points_t, unordered_ranks_t,
+    dropped_tracks_t, unordered_ranks_t, poll_t,
+    hit_list::counts::listing_window>;
+
+  /// Funkcje przeznaczone do notowań.
+  namespace hit_list::list {
+
+    /** Wyrzuca utwory z głosowania.
+     * @param previous - poprzednie notowanie;
+     * @param current - obecne notowanie;
+     * @param dropped - utwory, które wypadły.
+     */
+    inline void drop_tracks(unordered_ranks_t const &previous,
+                            unordered_ranks_t const &current,
+                            dropped_tracks_t &dropped) {
+
+      for (auto const &[id, rank]: previous) {
+        if (current.find(id) == current.end())
+          dropped.insert(id);
+      }
+    }
+
+    /** Resetuje głosy, aktualizuje max i zapisuje notowanie.
+     * @param previous - poprzednie notowanie;
+     * @param current - obecne notowanie;
+     * @param poll - głosy, przygotowane na utwory o numerach do max;
+     * @param max - maksymalny indeks dostępnych utworów;
+     * @param new_max - nowa wartość max.
+     */
+    inline void initialize_listing(unordered_ranks_t &previous,
+                                   unordered_ranks_t &current,
+                                   poll_t &poll,
+                                   track_id_t &max,
+                                   track_id_t const &new_max) {
+      previous.swap(current);
+      max = new_max;
+
+      poll.clear();
+      poll.grow(max);
+    }
+  }
+
+  /// Funkcje przeznaczone do głosowań.
+  namespace hit_list::poll {
+
+    /// Największa liczba głosów w linijce, dla której powtórzenia są
+    /// wyszukiwane w tablicy na stosie.
+    size_t const INLINE_VOTES = 16;
+
+    /** Sprawdza, czy w linijce nie zagłosowano dwa razy na ten sam utwór.
+     * Głosy są kopiowane i sortowane w tablicy na stosie, a tylko dla
+     * wyjątkowo długich linijek w wektorze na stercie.
+     * @param[in] ids - numery utworów odczytane z linijki.
+     * @return Wartość true, jeżeli głosy się nie powtarzają, false
+     * w przeciwnym razie.
+     */
+    inline bool unique_votes(track_span_t const ids) {
+      array<track_id_t, INLINE_VOTES> inline_votes;
+      track_ids_t heap_votes;
+      track_id_t *votes = inline_votes.data();
+
+      if (ids.size() > INLINE_VOTES) {
+        heap_votes.resize(ids.size());
+        votes = heap_votes.data();
+      }
+      copy(ids.begin(), ids.end(), votes);
+      sort(votes, votes + ids.size());
+      return adjacent_find(votes, votes + ids.size()) == votes + ids.size();
+    }
+
+    /** Sprawdza, czy głosy z linijki są poprawne.
+     * @param[in] dropped - utwory, które wypadły z głosowania;
+     * @param[in] ids - numery utworów odczytane z linijki;
+     * @param[in] max - maksymalny indeks utworu.
+     * @return Wartość true, jeżeli dane są poprawne, wartość false w
+     * przeciwnym razie. (Niepoprawne, jeżeli utwór przepadł, głos
+     * jest oddany ponad max lub powtórzony).
+     */
+    inline bool fetch_votes(dropped_tracks_t const &dropped,
+                            track_span_t const ids, track_id_t const &max) {
+
+      for (track_id_t const track_id: ids) {
+        if (track_id <= 0 || track_id > max || dropped.contains(track_id))
+          return false;
+      }
+      return unique_votes(ids);
+    }
+
+    /** Ustala, dlaczego głosy z linijki są niepoprawne. Wolniejsze niż
+     * fetch_votes(), przeznaczone tylko do statystyk.
+     * @param[in] dropped - utwory, które wypadły z głosowania;
+     * @param[in] ids - numery utworów odczytane z linijki;
+     * @param[in] max - maksymalny indeks utworu.
+     * @return Pierwszy napotkany powód błędu albo VoteValid.
+     */
+    inline vote_error_t classify_votes(dropped_tracks_t const &dropped,
+                                       track_span_t const ids,
+                                       track_id_t const &max) {
+      for (track_id_t const track_id: ids) {
+        if (track_id <= 0 || track_id > max)
+          return VoteOutOfRange;
+        if (dropped.contains(track_id))
+          return VoteDropped;
+      }
+      return unique_votes(ids) ? VoteValid : VoteRepeated;
+    }
+
+    /** Aktualizuje liczbę głosów na każdy utwór.
+     * @param poll - aktualne głosy w bieżącym głosowaniu;
+     * @param ids - poprawne, niepowtarzające się głosy w danej linijce.
+     */
+    inline void update_poll(poll_t &poll, track_span_t const ids) {
+      for (track_id_t const id: ids)
+        poll.add(id, 1);
+    }
+  }
+
+  /// Funkcje przeznaczone do podsumowań.
+  namespace hit_list::top {
+
+    /** Tworzy ranking siedmiu najlepszych utworów na podstawie zdobytych
+     * przez nie punktów.
+     * @param[in] points - liczniki zawierające numery i związane z nimi
+     * liczby punktów;
+     * @param[in] previous_ranking - ranking poprzedni, dostępny po numerze
+     * utworu;
+     * @param[out] ranking - ranking uporządkowany według pozycji, razem
+     * z pozycjami w rankingu poprzednim.
+     * @return Ranking dostępny po numerze utworu (bez zachowania porządku).
+     */
+    template <typename counts_t>
+    unordered_ranks_t fetch_ranking(counts_t const &points,
+                                    unordered_ranks_t const &previous_ranking,
+                                    ranking_t &ranking) {
+      top7_t const &best = points.ranking();
+      unordered_ranks_t updated_ranking;
+
+      ranking.clear();
+      for (size_t rank = 1; rank <= best.size(); rank++) {
+        auto const [id, count] = best[rank - 1];
+        auto const previous = previous_ranking.find(id);
+
+        ranking.push_back({id, count, (track_rank_t) rank,
+                           previous == previous_ranking.end()
+                               ? 0 : previous->second});
+        updated_ranking.insert({id, rank});
+      }
+
+      return updated_ranking;
+    }
+
+    /** Funkcja przyznaje punkty siedmiu pierwszym utworom na podstawie ich
+     * pozycji.
+     * @param[in] points - liczniki z generalną klasyfikacją punktową;
+     * @param[in] listing - nowe notowanie, zawierające siedem najlepszych
+     * utworów;
+     * @param[in] top_count - liczba utworów w notowaniu.
+     */
+    inline void grant_points(points_t &points,
+                             unordered_ranks_t const &listing,
+                             track_rank_t const top_count) {
+
+      for (const pair<const int, track_rank_t> &pair: listing)
+        points.add(pair.first, top_count + 1 - pair.second);
+    }
+  }
+
+  /** Binarny zapis stanu list przebojów. Plik zaczyna się napisem MAGIC
+   * i liczbą list, po czym dla każdej listy następują: nazwa, liczba utworów
+   * w notowaniu, MAX, pięć tablic odpowiadających pierwszym składowym
+   * hit_list_t, każda poprzedzona liczbą elementów, oraz rozmiar okna
+   * notowań i tablice punktów z kolejnych notowań w oknie. Elementy tablic
+   * mają stały rozmiar, więc tablica jest zapisywana i odczytywana w całości
+   * jednym wywołaniem, bez parsowania poszczególnych elementów. Liczby są
+   * zapisywane w kolejności bajtów komputera, na którym działa program.
+   */
+  namespace snapshot {
+
+    string_view const MAGIC("TOP7SNP2");
+
+    using size_record = uint64_t;
+
+    /// Licznik głosów (punktów) utworu.
+    struct count_record {
+      track_id_t id;
+      uint32_t padding;
+      uint64_t count;
+    };
+
+    /// Pozycja utworu w notowaniu (podsumowaniu).
+    struct rank_record {
+      track_id_t id;
+      track_rank_t rank;
+    };
+
+    /// Zapisuje do strumienia pojedynczą wartość.
+    template <typename T>
+    void write(ostream &out, T const &value) {
+      out.write(reinterpret_cast<char const *>(&value), sizeof(T));
+    }
+
+    /// Zapisuje do strumienia tablicę poprzedzoną liczbą jej elementów.
+    template <typename T>
+    void write_array(ostream &out, vector<T> const &values) {
+      write(out, (size_record) values.size());
+      out.write(reinterpret_cast<char const *>(values.data()),
+                values.size() * sizeof(T));
+    }
+
+    /// Zapisuje liczniki jako tablicę count_record.
+    template <typename counts_t>
+    void write_counts(ostream &out, counts_t const &counts) {
+      vector<count_record> records;
+      counts.for_each([&records](track_id_t const id, count_t const count) {
+        records.push_back({id, 0, count});
+      });
+      write_array(out, records);
+    }
+
+    /// Zapisuje rozkład miejsc jako tablicę rank_record.
+    inline void write_ranks(ostream &out, unordered_ranks_t const &ranks) {
+      vector<rank_record> records;
+      for (auto const &[id, rank]: ranks)
+        records.push_back({id, rank});
+      write_array(out, records);
+    }
+
+    /// Zawartość pliku stanu odczytywana od początku. Każda metoda zwraca
+    /// false, jeżeli w pliku zabrakło danych.
+    class input {
+    public:
+      explicit input(string_view const data) : data(data) {}
+
+      bool empty() const {
+        return data.empty();
+      }
+
+      /// Liczba nieodczytanych bajtów.
+      size_t size() const {
+        return data.length();
+      }
+
+      template <typename T>
+      bool read(T &value) {
+        return read_bytes(&value, sizeof(T));
+      }
+
+      template <typename T>
+      bool read_array(vector<T> &values) {
+        size_record n;
+        if (!read(n) || n > data.length() / sizeof(T))
+          return false;
+        values.resize(n);
+        return read_bytes(values.data(), n * sizeof(T));
+      }
+
+      bool read_string(string &value) {
+        size_record n;
+        if (!read(n) || n > data.length())
+          return false;
+        value = data.substr(0, n);
+        data.remove_prefix(n);
+        return true;
+      }
+
+    private:
+      string_view data;
+
+      bool read_bytes(void *to, size_t const n) {
+        if (n > data.length())
+          return false;
+        if (n > 0)
+          memcpy(to, data.data(), n);
+        data.remove_prefix(n);
+        return true;
+      }
+    };
+
+    /** Odczytuje liczniki zapisane przez write_counts().
+     * @param[in, out] in - plik stanu;
+     * @param[out] counts - puste liczniki, przygotowane na utwory do max;
+     * @param[in] max - największy dopuszczalny numer utworu albo 0, jeżeli
+     * numery nie są ograniczone.
+     * @return Wartość true, jeżeli dane są poprawne, false w przeciwnym
+     * razie.
+     */
+    template <typename counts_t>
+    bool read_counts(input &in, counts_t &counts, track_id_t const max) {
+      vector<count_record> records;
+      if (!in.read_array(records))
+        return false;
+
+      counts.reserve(records.size());
+      for (count_record const &r: records) {
+        if (r.id <= 0 || (max && r.id > max) || r.count == 0)
+          return false;
+        counts.add(r.id, r.count);
+      }
+      return true;
+    }
+
+    /// Zapisuje punkty z notowań w oknie jako tablice count_record.
+    inline void write_window(ostream &out,
+                             hit_list::counts::listing_window const &window) {
+      write(out, (size_record) window.size());
+      window.for_each([&out](top7_t const &listing) {
+        vector<count_record> records;
+        for (auto const &[id, count]: listing)
+          records.push_back({id, 0, count});
+        write_array(out, records);
+      });
+    }
+
+    /// Odczytuje rozkład miejsc zapisany przez write_ranks().
+    inline bool read_ranks(input &in, unordered_ranks_t &ranks) {
+      vector<rank_record> records;
+      if (!in.read_array(records))
+        return false;
+
+      ranks.reserve(records.size());
+      for (rank_record const &r: records)
+        ranks.emplace(r.id, r.rank);
+      return true;
+    }
+
+    /// Odczytuje punkty z notowań w oknie zapisane przez write_window().
+    inline bool read_window(input &in,
+                            hit_list::counts::listing_window &window) {
+      size_record size;
+      if (!in.read(size) || size > in.size())
+        return false;
+
+      window = hit_list::counts::listing_window(size);
+      for (size_record i = 0; i < size; i++) {
+        vector<count_record> records;
+        top7_t listing;
+        if (!in.read_array(records))
+          return false;
+        for (count_record const &r: records) {
+          if (r.id <= 0 || r.count == 0)
+            return false;
+          listing.push_back({r.id, r.count});
+        }
+        window.restore(std::move(listing));
+      }
+      return true;
+    }
+  }
+
+  /** Lista przebojów: stan notowań i podsumowań, bieżący MAX oraz liczba
+   * utworów w notowaniu. Pusta lista nie zajmuje pamięci poza samym
+   * obiektem, więc w jednym procesie może działać wiele list. Metody, które
+   * zwracają false, nie zmieniają stanu listy.
+   */
+  class chart {
+  public:
+    /** @param[in] top_count - liczba utworów w notowaniu (podsumowaniu);
+     * @param[in] window - liczba ostatnich notowań, z których punkty
+     * liczą się do podsumowania, albo 0, jeżeli liczą się wszystkie.
+     */
+    explicit chart(track_rank_t const top_count = DEFAULT_TOP_COUNT,
+                   size_t const window = 0)
+        : top_count(top_count),
+          data(points_t(top_count), unordered_ranks_t(), dropped_tracks_t(),
+               unordered_ranks_t(), poll_t(top_count),
+               hit_list::counts::listing_window(window)) {}
+
+    track_rank_t get_top_count() const {
+      return top_count;
+    }
+
+    size_t get_window() const {
+      return get<WINDOW>(data).size();
+    }
+
+    /** Sprawdza głosy z jednej linii, nie zmieniając stanu listy.
+     * @param[in] ids - utwory, na które zagłosowano.
+     * @return Wartość true, jeżeli głosy są poprawne, false w przeciwnym
+     * razie.
+     */
+    bool check_vote(track_span_t const ids) const {
+      return hit_list::poll::fetch_votes(get<DROPPED>(data), ids, max);
+    }
+
+    /// Powód, dla którego check_vote() odrzuca głosy, albo VoteValid.
+    vote_error_t vote_error(track_span_t const ids) const {
+      return hit_list::poll::classify_votes(get<DROPPED>(data), ids, max);
+    }
+
+    /** Oddaje głosy z jednej linii.
+     * @param[in] ids - utwory, na które zagłosowano.
+     * @return Wartość true, jeżeli głosy są poprawne, wartość false w
+     * przeciwnym razie. (Niepoprawne, jeżeli utwór przepadł, głos
+     * jest oddany ponad max lub powtórzony).
+     */
+    bool vote(track_span_t const ids) {
+      using namespace hit_list::poll;
+      if (fetch_votes(get<DROPPED>(data), ids, max))
+        update_poll(get<POLL>(data), ids);
+      else
+        return false;
+
+      return true;
+    }
+
+    /** Oddaje głosy z jednej linii, sprawdzone wcześniej przez check_vote().
+     * @param[in] ids - utwory, na które zagłosowano.
+     */
+    void add_vote(track_span_t const ids) {
+      hit_list::poll::update_poll(get<POLL>(data), ids);
+    }
+
+    /** Dolicza głosy zebrane poza listą, np. przez inny wątek.
+     * @param[in] votes - liczby głosów na poszczególne utwory, sprawdzone
+     * wcześniej przez check_vote().
+     */
+    void add_votes(count_per_track_t const &votes) {
+      for (auto const &[id, count]: votes)
+        get<POLL>(data).add(id, count);
+    }
+
+    /** Zamyka notowanie i rozpoczyna nowe (NEW MAX).
+     * @param[in] new_max - nowy MAX;
+     * @param[out] listing - zamknięte notowanie.
+     * @return Wartość true, jeżeli dane są poprawne, wartość false w
+     * przeciwnym razie. (Niepoprawne, jeżeli nowy max < stary max).
+     */
+    bool new_listing(track_id_t const new_max, ranking_t &listing) {
+      using namespace hit_list::list;
+      using hit_list::top::fetch_ranking;
+      using hit_list::top::grant_points;
+
+      if (new_max >= max) {
+        unordered_ranks_t &previous_listing = get<PREVIOUS_LISTING>(data);
+        unordered_ranks_t current_listing =
+            fetch_ranking(get<POLL>(data), previous_listing, listing);
+
+        grant_points(get<POINTS>(data), current_listing, top_count);
+        get<WINDOW>(data).add(get<POINTS>(data), current_listing, top_count);
+        drop_tracks(previous_listing, current_listing, get<DROPPED>(data));
+        compact();
+
+        initialize_listing(previous_listing, current_listing,
+                           get<POLL>(data), max, new_max);
+        return true;
+      }
+
+      return false;
+    }
+
+    /** Tworzy podsumowanie (TOP) i zastępuje nim poprzednie.
+     * @param[out] summary - podsumowanie.
+     */
+    void top(ranking_t &summary) {
+      unordered_ranks_t &previous_overall = get<PREVIOUS_OVERALL>(data);
+      unordered_ranks_t current_overall = hit_list::top::fetch_ranking(
+          get<POINTS>(data), previous_overall, summary);
+
+      previous_overall.swap(current_overall);
+    }
+
+    /// Przybliżona pamięć zajmowana przez listę.
+    memory_t memory() const {
+      return {get<POINTS>(data).size(), get<POINTS>(data).memory(),
+              get<DROPPED>(data).size(), get<DROPPED>(data).memory(),
+              get<POLL>(data).memory(), get<WINDOW>(data).memory(),
+              compacted_tracks, get<POINTS>(data).buckets(),
+              get<POLL>(data).size(), get<POLL>(data).buckets()};
+    }
+
+    /** Zapisuje stan listy w formacie opisanym w snapshot.
+     * @param[in, out] out - strumień pliku stanu.
+     */
+    void save(ostream &out) const {
+      using namespace snapshot;
+      vector<track_id_t> dropped;
+
+      get<DROPPED>(data).for_each([&dropped](track_id_t const id) {
+        dropped.push_back(id);
+      });
+
+      write(out, top_count);
+      write(out, max);
+      write_counts(out, get<POINTS>(data));
+      write_ranks(out, get<PREVIOUS_OVERALL>(data));
+      write_array(out, dropped);
+      write_ranks(out, get<PREVIOUS_LISTING>(data));
+      write_counts(out, get<POLL>(data));
+      write_window(out, get<WINDOW>(data));
+    }
+
+    /** Odczytuje stan listy zapisany przez save(), zastępując bieżący.
+     * @param[in, out] in - plik stanu.
+     * @return Wartość true, jeżeli dane są poprawne, false w przeciwnym
+     * razie.
+     */
+    bool load(snapshot::input &in) {
+      chart loaded;
+      if (!loaded.read(in))
+        return false;
+
+      *this = std::move(loaded);
+      return true;
+    }
+
+  private:
+    track_rank_t top_count;
+    track_id_t max = 0; // MAX=0 przed notowaniem.
+    hit_list_t data;
+    /// Liczba liczników punktów po ostatnim kompaktowaniu.
+    size_t compacted_size = 0;
+    /// Liczba liczników punktów usuniętych przez kompaktowanie.
+    size_t compacted_tracks = 0;
+
+    /** Kompaktuje zbiór utworów, które wypadły, oraz usuwa punkty tych
+     * utworów, które nie mogą już wrócić do podsumowania. Utwór, który
+     * wypadł, nie dostanie już punktów, a bez okna notowań punkty innych
+     * utworów tylko rosną, więc utwór z mniejszą liczbą punktów niż ostatni
+     * z najlepszych nigdy nie znajdzie się wśród nich. Punkty są przeglądane
+     * dopiero wtedy, gdy ich tablica podwoiła się od ostatniego przeglądu,
+     * więc koszt rozkłada się na dodawanie punktów.
+     */
+    void compact() {
+      using hit_list::counts::COMPACT_MIN_TRACKS;
+      points_t &points = get<POINTS>(data);
+      dropped_tracks_t const &dropped = get<DROPPED>(data);
+
+      get<DROPPED>(data).compact();
+      if (get<WINDOW>(data).size() > 0 ||
+          points.size() < 2 * compacted_size + COMPACT_MIN_TRACKS)
+        return;
+
+      top7_t const &best = points.ranking();
+      if (best.size() == (size_t) top_count) {
+        count_t const threshold = best.back().second;
+        compacted_tracks += points.erase_if(
+            [&dropped, threshold](track_id_t const id, count_t const count) {
+          return count < threshold && dropped.contains(id);
+        });
+      }
+      compacted_size = points.size();
+    }
+
+    /** Odczytuje do nowo utworzonej listy stan zapisany przez save().
+     * Zmienia listę, zanim sprawdzi cały plik, więc load() podstawia jej
+     * wynik za bieżący stan dopiero po udanym odczycie.
+     * @param[in, out] in - plik stanu.
+     * @return Wartość true, jeżeli dane są poprawne, false w przeciwnym
+     * razie.
+     */
+    bool read(snapshot::input &in) {
+      using namespace snapshot;
+      vector<track_id_t> dropped;
+
+      if (!in.read(top_count) || !in.read(max) || top_count <= 0 || max < 0)
+        return false;
+
+      data = hit_list_t(points_t(top_count), unordered_ranks_t(),
+                        dropped_tracks_t(), unordered_ranks_t(),
+                        poll_t(top_count), hit_list::counts::listing_window());
+      get<POLL>(data).grow(max);
+      compacted_size = compacted_tracks = 0;
+
+      if (!read_counts(in, get<POINTS>(data), 0) ||
+          !read_ranks(in, get<PREVIOUS_OVERALL>(data)) ||
+          !in.read_array(dropped) ||
+          !read_ranks(in, get<PREVIOUS_LISTING>(data)) ||
+          !read_counts(in, get<POLL>(data), max) ||
+          !read_window(in, get<WINDOW>(data)) ||
+          !get<WINDOW>(data).covered_by(get<POINTS>(data)))
+        return false;
+
+      for (track_id_t const id: dropped) {
+        if (id <= 0 || id > max)
+          return false;
+        get<DROPPED>(data).insert(id);
+      }
+      get<DROPPED>(data).compact();
+      return true;
+    }
+  };
+}
+
+#endif // TOP7_H
@@ -0,0 +1,178 @@
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+
+#include "top7.h"
+
+/** Porównanie obu układów liczników głosów i zbioru utworów, które wypadły,
+ * z top7.h: tablic haszujących (domyślnych) i tablic indeksowanych numerem
+ * utworu (-DTOP7_DENSE). Dla każdego MAX z listy głosy trafiają na te same
+ * utwory, rozrzucone po przedziale [1, MAX], więc różnice wynikają tylko
+ * z wielkości MAX, a nie z liczby utworów, na które się głosuje.
+ */
+
+using std::string, std::string_view, std::vector;
+using top7::track_id_t, top7::track_ids_t;
+
+namespace {
+
+  using clock_t = std::chrono::steady_clock;
+
+  /// Parametry porównania.
+  struct options_t {
+    /// Liczba utworów, na które się głosuje.
+    long tracks = 10000;
+    /// Liczba notowań.
+    long listings = 100;
+    /// Liczba głosów w notowaniu.
+    long votes = 100000;
+    /// Liczba utworów wypadających w każdym notowaniu.
+    long drops = 7;
+    /// Porównywane wartości MAX.
+    vector<long> max_values = {1000, 100000, 10000000, 99999999};
+    /// Ziarno generatora liczb losowych.
+    unsigned long seed = 1;
+  };
+
+  /// Wynik jednego przebiegu.
+  struct result_t {
+    /// Średni czas sprawdzenia i dodania głosu w nanosekundach.
+    double ns_per_vote;
+    /// Największa pamięć liczników i zbioru utworów, które wypadły.
+    size_t memory;
+  };
+
+  /** Głosy kolejnych notowań: numery utworów z przedziału [1, max], z których
+   * część jest dużo popularniejsza od reszty.
+   */
+  vector<track_ids_t> make_votes(options_t const &options, long const max) {
+    std::mt19937_64 random(options.seed);
+    std::uniform_real_distribution<double> uniform;
+    long const tracks = std::min(options.tracks, max);
+    track_ids_t ids(tracks);
+
+    for (track_id_t &id: ids)
+      id = std::uniform_int_distribution<long>(1, max)(random);
+
+    vector<track_ids_t> votes(options.listings);
+    for (track_ids_t &listing: votes) {
+      listing.reserve(options.votes);
+      for (long i = 0; i < options.votes; i++) {
+        double const u = uniform(random);
+        listing.push_back(ids[(size_t) (u * u * tracks)]);
+      }
+    }
+    return votes;
+  }
+
+  /** Wykonuje głosowania tak jak top7: przed dodaniem głosu sprawdza, czy
+   * utwór nie wypadł, a na koniec notowania kilka najlepszych utworów
+   * wypada i liczniki są zerowane.
+   */
+  template <typename counts_t, typename tracks_t>
+  result_t run(vector<track_ids_t> const &votes, long const max,
+               options_t const &options) {
+    counts_t counts(top7::DEFAULT_TOP_COUNT);
+    tracks_t dropped;
+    size_t memory = 0, added = 0;
+
+    clock_t::time_point const start = clock_t::now();
+    for (track_ids_t const &listing: votes) {
+      counts.grow(max);
+      for (track_id_t const id: listing) {
+        if (!dropped.contains(id)) {
+          counts.add(id, 1);
+          added++;
+        }
+      }
+
+      top7::top7_t const &best = counts.ranking();
+      for (long i = 0; i < options.drops && i < (long) best.size(); i++)
+        dropped.insert(best[i].first);
+      dropped.compact();
+      memory = std::max(memory, counts.memory() + dropped.memory());
+      counts.clear();
+    }
+    std::chrono::duration<double, std::nano> const time =
+        clock_t::now() - start;
+    return {time.count() / std::max<size_t>(added, 1), memory};
+  }
+
+  /** Odczytuje opcje wywołania programu.
+   * @param[in] argc, argv - argumenty wywołania;
+   * @param[out] options - odczytane opcje.
+   * @return True, jeżeli opcje są poprawne, false w przeciwnym razie.
+   */
+  bool parse_options(int argc, char *argv[], options_t &options) {
+    bool max_given = false;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+      string_view const arg(argv[i]);
+      char const *value = argv[i + 1];
+
+      try {
+        if (arg == "-t") {
+          options.tracks = std::stol(value);
+        } else if (arg == "-l") {
+          options.listings = std::stol(value);
+        } else if (arg == "-v") {
+          options.votes = std::stol(value);
+        } else if (arg == "-d") {
+          options.drops = std::stol(value);
+        } else if (arg == "-m") {
+          if (!max_given)
+            options.max_values.clear();
+          max_given = true;
+          options.max_values.push_back(std::stol(value));
+        } else if (arg == "-s") {
+          options.seed = std::stoul(value);
+        } else {
+          return false;
+        }
+      } catch (std::exception const &) {
+        return false;
+      }
+    }
+    return argc % 2 == 1 && options.tracks > 0 && options.listings > 0 &&
+           options.votes > 0 && options.drops >= 0 &&
+           std::all_of(options.max_values.begin(), options.max_values.end(),
+                       [](long const max) {
+                         return max > 0 && max <= 99999999;
+                       });
+  }
+}
+
+/** Uruchomienie: top7_bench [-t UTWORY] [-l NOTOWANIA] [-v GŁOSY]
+ * [-d WYPADAJĄCE] [-m MAX]... [-s ZIARNO].
+ * Dla każdego MAX (domyślnie 1000, 100000, 10000000 i 99999999) wypisuje
+ * średni czas sprawdzenia i dodania głosu oraz największą pamięć liczników
+ * i zbioru utworów, które wypadły, w obu układach z top7.h.
+ */
+int main(int argc, char *argv[]) {
+  options_t options;
+  if (!parse_options(argc, argv, options)) {
+    std::cerr << "Usage: " << argv[0] << " [-t TRACKS] [-l LISTINGS]"
+              << " [-v VOTES] [-d DROPS] [-m MAX]... [-s SEED]" << std::endl;
+    return 1;
+  }
+
+  using namespace top7::hit_list::counts;
+  printf("%10s %8s %10s %14s\n", "MAX", "layout", "ns/vote", "memory [B]");
+  for (long const max: options.max_values) {
+    vector<track_ids_t> const votes = make_votes(options, max);
+    result_t const hashed =
+        run<hashed_counts, range_tracks>(votes, max, options);
+    result_t const dense = run<dense_counts, dense_tracks>(votes, max, options);
+
+    printf("%10ld %8s %10.1f %14zu\n", max, "hashed", hashed.ns_per_vote,
+           hashed.memory);
+    printf("%10ld %8s %10.1f %14zu\n", max, "dense", dense.ns_per_vote,
+           dense.memory);
+  }
+  return 0;
+}
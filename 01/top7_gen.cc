@@ -0,0 +1,219 @@
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+/** Generator syntetycznych danych wejściowych dla top7. Popularność utworów
+ * ma rozkład Zipfa: utwór na r-tym miejscu pod względem popularności
+ * dostaje głos z prawdopodobieństwem proporcjonalnym do 1 / r^s. Kolejność
+ * popularności przesuwa się przy każdym NEW, więc utwory wypadają z
+ * notowań, a część głosów trafia na utwory, które wypadły.
+ */
+
+using std::string, std::string_view, std::vector;
+
+namespace {
+
+  /// Parametry generowanych danych.
+  struct options_t {
+    /// Liczba linii.
+    long lines = 1000000;
+    /// Największy numer utworu.
+    long tracks = 100000;
+    /// Początkowy MAX.
+    long initial_max = 1000;
+    /// Średni przyrost MAX przy NEW.
+    long growth = 100;
+    /// Wykładnik rozkładu Zipfa.
+    double zipf = 1.1;
+    /// O ile miejsc przesuwa się kolejność popularności przy NEW.
+    long drift = 3;
+    /// Największa liczba utworów w jednym głosie.
+    long votes_per_line = 7;
+    /// Prawdopodobieństwa linii z NEW, TOP i linii niepoprawnych.
+    double new_ratio = 0.001, top_ratio = 0.0001, invalid_ratio = 0.01;
+    /// Ziarno generatora liczb losowych.
+    unsigned long seed = 1;
+  };
+
+  /** Generator linii wejścia. */
+  class generator {
+  public:
+    explicit generator(options_t const &options)
+        : options(options), random(options.seed), max(options.initial_max) {
+      double sum = 0;
+      cdf.reserve(options.tracks);
+      for (long r = 1; r <= options.tracks; r++) {
+        sum += 1 / std::pow((double) r, options.zipf);
+        cdf.push_back(sum);
+      }
+    }
+
+    /// Dopisuje do @p out kolejną linię razem ze znakiem końca linii.
+    void next_line(string &out) {
+      double const p = uniform(random);
+
+      if (p < options.new_ratio)
+        new_line(out);
+      else if (p < options.new_ratio + options.top_ratio)
+        out += "TOP";
+      else if (p < options.new_ratio + options.top_ratio +
+                   options.invalid_ratio)
+        invalid_line(out);
+      else
+        vote_line(out);
+      out += '\n';
+    }
+
+  private:
+    options_t const &options;
+    std::mt19937_64 random;
+    std::uniform_real_distribution<double> uniform;
+    /// Dystrybuanta rozkładu Zipfa (bez normalizacji).
+    vector<double> cdf;
+    long max;
+    long shift = 0;
+    vector<long> ids;
+
+    /// Losuje numer utworu z przedziału [1, max] według popularności.
+    long popular_track() {
+      double const x = uniform(random) * cdf[max - 1];
+      long const rank = std::upper_bound(cdf.begin(), cdf.begin() + max, x)
+                        - cdf.begin();
+      return (std::min(rank, max - 1) + shift) % max + 1;
+    }
+
+    void new_line(string &out) {
+      long const step = options.growth
+          ? std::uniform_int_distribution<long>(0, 2 * options.growth)(random)
+          : 0;
+      max = std::min(max + step, options.tracks);
+      shift += options.drift;
+      out += "NEW ";
+      out += std::to_string(max);
+    }
+
+    void vote_line(string &out) {
+      long const count = std::uniform_int_distribution<long>(
+          1, std::min(options.votes_per_line, max))(random);
+
+      ids.clear();
+      while ((long) ids.size() < count) {
+        long const id = popular_track();
+        if (std::find(ids.begin(), ids.end(), id) == ids.end())
+          ids.push_back(id);
+      }
+      for (size_t i = 0; i < ids.size(); i++) {
+        if (i > 0)
+          out += ' ';
+        out += std::to_string(ids[i]);
+      }
+    }
+
+    void invalid_line(string &out) {
+      long const id = popular_track();
+
+      switch (std::uniform_int_distribution<int>(0, 5)(random)) {
+        case 0:
+          out += std::to_string(id) + " " + std::to_string(id);
+          break;
+        case 1:
+          out += std::to_string(max + 1 + id);
+          break;
+        case 2:
+          out += "0" + std::to_string(id);
+          break;
+        case 3:
+          out += "NEW " + std::to_string(max > 1 ? max - 1 : 0);
+          break;
+        case 4:
+          out += "TOP " + std::to_string(id);
+          break;
+        default:
+          out += "vote " + std::to_string(id);
+          break;
+      }
+    }
+  };
+
+  /** Odczytuje opcje wywołania programu.
+   * @param[in] argc, argv - argumenty wywołania;
+   * @param[out] options - odczytane opcje.
+   * @return True, jeżeli opcje są poprawne, false w przeciwnym razie.
+   */
+  bool parse_options(int argc, char *argv[], options_t &options) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+      string_view const arg(argv[i]);
+      char const *value = argv[i + 1];
+
+      try {
+        if (arg == "-n")
+          options.lines = std::stol(value);
+        else if (arg == "-t")
+          options.tracks = std::stol(value);
+        else if (arg == "-m")
+          options.initial_max = std::stol(value);
+        else if (arg == "-g")
+          options.growth = std::stol(value);
+        else if (arg == "-z")
+          options.zipf = std::stod(value);
+        else if (arg == "-d")
+          options.drift = std::stol(value);
+        else if (arg == "-v")
+          options.votes_per_line = std::stol(value);
+        else if (arg == "-N")
+          options.new_ratio = std::stod(value);
+        else if (arg == "-T")
+          options.top_ratio = std::stod(value);
+        else if (arg == "-i")
+          options.invalid_ratio = std::stod(value);
+        else if (arg == "-s")
+          options.seed = std::stoul(value);
+        else
+          return false;
+      } catch (std::exception const &) {
+        return false;
+      }
+    }
+    return argc % 2 == 1 && options.lines >= 0 && options.tracks > 0 &&
+           options.initial_max > 0 && options.initial_max <= options.tracks &&
+           options.growth >= 0 && options.drift >= 0 &&
+           options.votes_per_line > 0;
+  }
+}
+
+/** Uruchomienie: top7_gen [-n LINIE] [-t UTWORY] [-m MAX] [-g PRZYROST]
+ * [-z S] [-d PRZESUNIĘCIE] [-v GŁOSY] [-N P] [-T P] [-i P] [-s ZIARNO].
+ * Wypisuje na wyjście standardowe LINIE linii wejścia dla top7. Pierwsza
+ * linia to NEW z początkowym MAX; kolejne to głosy na co najwyżej GŁOSY
+ * różnych utworów, a z prawdopodobieństwem odpowiednio -N, -T i -i polecenia
+ * NEW, TOP i linie niepoprawne. Te same parametry i ziarno dają zawsze te
+ * same dane, więc można ich używać do porównywania kolejnych wersji top7.
+ */
+int main(int argc, char *argv[]) {
+  options_t options;
+  if (!parse_options(argc, argv, options)) {
+    std::cerr << "Usage: " << argv[0] << " [-n LINES] [-t TRACKS] [-m MAX]"
+              << " [-g GROWTH] [-z S] [-d DRIFT] [-v VOTES] [-N P] [-T P]"
+              << " [-i P] [-s SEED]" << std::endl;
+    return 1;
+  }
+
+  generator gen(options);
+  string out = "NEW " + std::to_string(options.initial_max) + "\n";
+
+  for (long line = 1; line < options.lines; line++) {
+    gen.next_line(out);
+    if (out.size() >= (1 << 16)) {
+      fwrite(out.data(), 1, out.size(), stdout);
+      out.clear();
+    }
+  }
+  if (options.lines > 0)
+    fwrite(out.data(), 1, out.size(), stdout);
+  return 0;
+}
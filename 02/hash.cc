@@ -1,8 +1,24 @@
 #include "hash.h"
 #include <unordered_set>
-#include <unordered_map>
 #include <iostream>
 #include <vector>
+#include <algorithm>
+#include <shared_mutex>
+#include <mutex>
+#include <type_traits>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cassert>
+#include <optional>
+#include <limits>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #ifndef NDEBUG
 bool const debug = true;
@@ -10,32 +26,1009 @@ bool const debug = true;
 bool const debug = false;
 #endif
 
-using std::unordered_set, std::unordered_map, std::vector, std::pair,
+// Kompilowanie z -DHASH_FLAT wybiera flat_set zamiast node_set.
+#ifdef HASH_FLAT
+bool const flat_storage = true;
+#else
+bool const flat_storage = false;
+#endif
+
+using std::unordered_set, std::vector, std::pair,
     std::size_t, std::cerr, std::endl, std::string, std::to_string;
+using std::shared_lock, std::unique_lock, std::lock_guard;
+using std::equal, std::conditional_t, std::optional, std::unique_ptr,
+    std::make_unique, std::atomic, std::memory_order_relaxed,
+    std::memory_order_acquire, std::memory_order_release,
+    std::memory_order_seq_cst;
 
 namespace jnp1 {
   using id_t = unsigned long;
-  using key_t = vector<uint64_t>;
+  // Ciąg podany przez użytkownika, bez kopiowania. Wyszukiwanie w tablicy
+  // przyjmuje go wprost, więc ciąg jest kopiowany tylko przy wstawianiu.
+  // Jak std::span z C++20, ale tylko tyle, ile potrzeba tablicom.
+  class key_view_t {
+  public:
+    key_view_t(uint64_t const *data, size_t size) : ptr(data), length(size) {}
+
+    uint64_t const *data() const { return ptr; }
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    uint64_t const *begin() const { return ptr; }
+    uint64_t const *end() const { return ptr + length; }
+    uint64_t operator[](size_t i) const { return ptr[i]; }
+
+  private:
+    uint64_t const *ptr;
+    size_t length;
+  };
+
+  // Klucz węzła node_set. Klucz wstawiany do tablicy ma własną kopię ciągu,
+  // a klucz do wyszukiwania tylko wskazuje ciąg wołającego, więc find() nie
+  // kopiuje ciągu także bez wyszukiwania heterogenicznego z C++20.
+  class key_t {
+  public:
+    explicit key_t(key_view_t k) : view(k) {}
+
+    static key_t copy_of(key_view_t k) {
+      key_t key(k);
+      key.owned.reset(new uint64_t[k.size()]);
+      std::copy(k.begin(), k.end(), key.owned.get());
+      key.view = key_view_t(key.owned.get(), k.size());
+      return key;
+    }
+
+    operator key_view_t() const { return view; }
+
+    size_t size() const { return view.size(); }
+
+  private:
+    // Przeniesienie zostawia tablicę słów w miejscu, więc view pozostaje
+    // ważny; kopiowanie jest zabronione przez unique_ptr.
+    unique_ptr<uint64_t[]> owned;
+    key_view_t view;
+  };
+
+  namespace {
+    // Zamienniki funkcji z <bit> z C++20 dla x > 0.
+    int floor_log2(uint64_t x) { return 63 - __builtin_clzll(x); }
+
+    bool is_power_of_two(uint64_t x) { return x != 0 && (x & (x - 1)) == 0; }
+
+    uint64_t ceil_power_of_two(uint64_t x) {
+      return x <= 1 ? 1 : uint64_t(2) << floor_log2(x - 1);
+    }
+  }
+
+  // Wbudowane funkcje haszujące, wybierane w hash_create_builtin().
+  namespace {
+    uint64_t const PRIME[] = {
+      0xa0761d6478bd642full, 0xe7037ed1a0b428dbull,
+      0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull
+    };
+
+    // Mnożenie 64 x 64 -> 128 bitów i złożenie obu połówek wyniku.
+    uint64_t mum(uint64_t a, uint64_t b) {
+      unsigned __int128 r = (unsigned __int128) a * b;
+      return uint64_t(r) ^ uint64_t(r >> 64);
+    }
+
+    // Jak wyhash: dwa wyrazy naraz, jedno mnożenie na parę. Najszybsza dla
+    // krótkich ciągów.
+    uint64_t wymix_hash(key_view_t k) {
+      uint64_t h = PRIME[0] ^ k.size();
+      size_t i = 0;
+      for (; i + 2 <= k.size(); i += 2)
+        h = mum(k[i] ^ PRIME[1], k[i + 1] ^ h);
+      if (i < k.size())
+        h = mum(k[i] ^ PRIME[1], h ^ PRIME[2]);
+      return mum(h ^ PRIME[3], k.size() ^ PRIME[1]);
+    }
+
+    // Krok jednego pasa: mnożenie 32 x 32 -> 64 bity jak w XXH3.
+    uint64_t lane_step(uint64_t acc, uint64_t word, uint64_t prime) {
+      uint64_t x = word ^ prime;
+      return acc + uint64_t(uint32_t(x)) * uint32_t(x >> 32) + word;
+    }
+
+    // Cztery niezależne pasy, każdy dostaje co czwarty wyraz, więc ich
+    // mnożenia wykonują się równolegle. Najszybsza dla długich ciągów.
+    uint64_t lanes_hash(key_view_t k) {
+      uint64_t a0 = PRIME[0], a1 = PRIME[1], a2 = PRIME[2], a3 = PRIME[3];
+      size_t i = 0;
+      for (; i + 4 <= k.size(); i += 4) {
+        a0 = lane_step(a0, k[i], PRIME[0]);
+        a1 = lane_step(a1, k[i + 1], PRIME[1]);
+        a2 = lane_step(a2, k[i + 2], PRIME[2]);
+        a3 = lane_step(a3, k[i + 3], PRIME[3]);
+      }
 
+      uint64_t h = mum(a0 ^ a2, a1 ^ a3 ^ k.size());
+      for (; i < k.size(); i++)
+        h = mum(k[i] ^ PRIME[1], h ^ PRIME[2]);
+      return mum(h ^ PRIME[3], a0 + a1 + a2 + a3);
+    }
+  }
+
+  // Funkcja haszująca użytkownika albo wbudowana funkcja wywoływana
+  // bezpośrednio, bez wskaźnika. Którą z nich wybrano, mówi is_builtin,
+  // a nie pusty wskaźnik, więc hash_function nigdy nie jest NULL.
   struct custom_hash {
+    using is_transparent = void;
+
     hash_function_t hash_function;
+    bool is_builtin;
+    hash_builtin_t builtin;
+
+    size_t operator()(key_view_t k) const {
+      if (!is_builtin) return hash_function(k.data(), k.size());
+      return builtin == HASH_BUILTIN_LANES ? lanes_hash(k) : wymix_hash(k);
+    }
 
     size_t operator()(const key_t &k) const {
-      return hash_function(k.data(), k.size());
+      return (*this)(key_view_t(k));
+    }
+
+    explicit custom_hash(hash_function_t hf)
+        : hash_function(hf), is_builtin(false), builtin(HASH_BUILTIN_WYMIX) {
+      assert(hf);
+    }
+
+    explicit custom_hash(hash_builtin_t builtin)
+        : hash_function(nullptr), is_builtin(true), builtin(builtin) {}
+  };
+
+  struct key_equal {
+    using is_transparent = void;
+
+    bool operator()(key_view_t a, key_view_t b) const {
+      return equal(a.begin(), a.end(), b.begin(), b.end());
+    }
+  };
+
+  // Każdy ciąg w osobnym węźle unordered_set, z własną kopią słów.
+  class node_set {
+  public:
+    node_set(size_t bucket_count, custom_hash hash)
+        : set(bucket_count, hash) {}
+
+    size_t size() const { return set.size(); }
+
+    bool empty() const { return set.empty(); }
+
+    bool contains(key_view_t k) const { return find(k) != set.end(); }
+
+    // Wywołuje result(i, contains(key(i))) dla i = 0, ..., n - 1. Pusty
+    // ciąg nie jest haszowany, tylko od razu uznawany za nieobecny.
+    template <typename K, typename R>
+    void contains_many(size_t n, K key, R result) const {
+      for (size_t i = 0; i < n; i++)
+        result(i, !key(i).empty() && contains(key(i)));
+    }
+
+    // Ciąg jest najpierw szukany bez kopiowania, bo insert() dostaje już
+    // kopię, zanim sprawdzi, czy ciąg już jest.
+    bool insert(key_view_t k) {
+      if (contains(k)) return false;
+      size_t buckets = set.bucket_count();
+      set.insert(key_t::copy_of(k));
+      if (set.bucket_count() != buckets) rehashes++;
+      words += k.size();
+      return true;
+    }
+
+    // Powiększa tablicę tak, żeby n ciągów mieściło się bez rehash().
+    // Samo unordered_set::reserve() mogłoby ją też zmniejszyć.
+    void reserve(size_t n) {
+      if (n <= set.bucket_count() * set.max_load_factor()) return;
+      set.reserve(n);
+      if (!set.empty()) rehashes++;
+    }
+
+    size_t bucket_count() const { return set.bucket_count(); }
+
+    // Liczba przebudowań niepustej tablicy.
+    size_t rehash_count() const { return rehashes; }
+
+    bool erase(key_view_t k) {
+      auto it = find(k);
+      if (it == set.end()) return false;
+      words -= it->size();
+      set.erase(it);
+      return true;
+    }
+
+    void clear() {
+      set.clear();
+      words = 0;
+    }
+
+    // Wywołuje f(ciąg) dla każdego ciągu w tablicy.
+    template <typename F>
+    void for_each(F f) const {
+      for (const key_t &k : set)
+        f(key_view_t(k));
+    }
+
+    // Przybliżona liczba zajmowanych bajtów: kubełki, węzły (wskaźnik na
+    // następny, zapamiętany hasz, key_t) i skopiowane słowa ciągów.
+    size_t memory() const {
+      return set.bucket_count() * sizeof(void *) +
+             set.size() * (sizeof(void *) + sizeof(size_t) + sizeof(key_t)) +
+             words * sizeof(uint64_t);
+    }
+
+  private:
+    using set_t = unordered_set<key_t, custom_hash, key_equal>;
+
+    set_t set;
+    size_t rehashes = 0;
+    // Łączna długość ciągów, żeby memory() nie przeglądało węzłów.
+    size_t words = 0;
+
+    set_t::const_iterator find(key_view_t k) const {
+      return set.find(key_t(k));
+    }
+  };
+
+  // Adresowanie otwarte z próbkowaniem liniowym. Slot trzyma pełny hasz
+  // ciągu i jego położenie w arenie, w której ciągi tablicy leżą jeden za
+  // drugim, każdy poprzedzony swoją długością. Porównanie zaczyna się od
+  // hasza, a powiększanie korzysta tylko z haszy, więc funkcja użytkownika
+  // jest wołana raz na operację. Usunięty ciąg zostaje w arenie do
+  // najbliższego rehash(), który przepisuje arenę bez usuniętych ciągów.
+  class flat_set {
+  public:
+    flat_set(size_t bucket_count, custom_hash hash) : hash(hash) {
+      allocate(bucket_count);
+    }
+
+    size_t size() const { return count; }
+
+    bool empty() const { return count == 0; }
+
+    bool contains(key_view_t k) const { return find(k, hash(k)) != NONE; }
+
+    // Jak node_set::contains_many(), ale hasze kolejnych PREFETCH_GROUP
+    // ciągów są liczone z góry, a ich pierwsze sloty ściągane do pamięci
+    // podręcznej, zanim zacznie się porównywanie.
+    template <typename K, typename R>
+    void contains_many(size_t n, K key, R result) const {
+      size_t hashes[PREFETCH_GROUP];
+
+      for (size_t begin = 0; begin < n; begin += PREFETCH_GROUP) {
+        size_t end = std::min(n, begin + PREFETCH_GROUP);
+        for (size_t i = begin; i < end; i++) {
+          if (key(i).empty()) continue;
+          hashes[i - begin] = hash(key(i));
+          __builtin_prefetch(&slots[home(hashes[i - begin])]);
+        }
+        for (size_t i = begin; i < end; i++)
+          result(i, !key(i).empty() &&
+                    find(key(i), hashes[i - begin]) != NONE);
+      }
+    }
+
+    bool insert(key_view_t k) {
+      size_t h = hash(k);
+      if (find(k, h) != NONE) return false;
+
+      // Co najmniej ćwierć slotów zostaje pustych, więc find() się kończy.
+      if ((count + deleted + 1) * 4 > slots.size() * 3)
+        rehash((count + 1) * 2 > slots.size() ? slots.size() * 2
+                                              : slots.size());
+
+      size_t i = home(h);
+      while (slots[i].offset != EMPTY && slots[i].offset != DELETED)
+        i = (i + 1) & mask;
+      if (slots[i].offset == DELETED) deleted--;
+
+      slots[i] = {h, arena.size()};
+      arena.push_back(k.size());
+      arena.insert(arena.end(), k.begin(), k.end());
+      count++;
+      return true;
+    }
+
+    bool erase(key_view_t k) {
+      size_t i = find(k, hash(k));
+      if (i == NONE) return false;
+
+      garbage += 1 + arena[slots[i].offset];
+      slots[i].offset = DELETED;
+      count--;
+      deleted++;
+      if (garbage * 2 > arena.size()) rehash(slots.size());
+      return true;
+    }
+
+    void reserve(size_t n) {
+      if (n + n / 3 + 1 > slots.size()) rehash(n + n / 3 + 1);
+    }
+
+    size_t bucket_count() const { return slots.size(); }
+
+    size_t rehash_count() const { return rehashes; }
+
+    void clear() {
+      std::fill(slots.begin(), slots.end(), slot_t{0, EMPTY});
+      arena.clear();
+      count = deleted = garbage = 0;
+    }
+
+    size_t memory() const {
+      return slots.capacity() * sizeof(slot_t) +
+             arena.capacity() * sizeof(uint64_t);
+    }
+
+    template <typename F>
+    void for_each(F f) const {
+      for (const slot_t &s : slots) {
+        if (s.offset != EMPTY && s.offset != DELETED)
+          f(key_view_t(arena.data() + s.offset + 1, arena[s.offset]));
+      }
+    }
+
+  private:
+    struct slot_t {
+      size_t hash;
+      size_t offset;
+    };
+
+    // Wartości offset wolnego slotu i slotu po usuniętym ciągu.
+    static size_t const EMPTY = -1;
+    static size_t const DELETED = -2;
+    static size_t const NONE = -1;
+    static size_t const PREFETCH_GROUP = 8;
+
+    custom_hash hash;
+    vector<slot_t> slots;
+    vector<uint64_t> arena;
+    size_t mask = 0, shift = 0;
+    size_t count = 0, deleted = 0;
+    // Liczba słów areny zajętych przez usunięte ciągi.
+    size_t garbage = 0;
+    size_t rehashes = 0;
+
+    void allocate(size_t bucket_count) {
+      size_t capacity = 2;
+      shift = 63;
+      while (capacity < bucket_count) {
+        capacity *= 2;
+        shift--;
+      }
+      slots.assign(capacity, slot_t{0, EMPTY});
+      mask = capacity - 1;
+    }
+
+    // Pierwszy slot dla hasza. Haszowanie Fibonacciego rozrzuca też hasze
+    // różniące się tylko starszymi bitami.
+    size_t home(size_t h) const {
+      return (h * 0x9E3779B97F4A7C15ull) >> shift;
+    }
+
+    size_t find(key_view_t k, size_t h) const {
+      for (size_t i = home(h); slots[i].offset != EMPTY;
+           i = (i + 1) & mask) {
+        const slot_t &s = slots[i];
+        if (s.hash == h && s.offset != DELETED &&
+            arena[s.offset] == k.size() &&
+            equal(k.begin(), k.end(), arena.begin() + s.offset + 1))
+          return i;
+      }
+      return NONE;
+    }
+
+    void rehash(size_t bucket_count) {
+      if (count > 0) rehashes++;
+      vector<slot_t> old_slots;
+      vector<uint64_t> old_arena;
+      old_slots.swap(slots);
+      old_arena.swap(arena);
+
+      allocate(bucket_count);
+      arena.reserve(old_arena.size() - garbage);
+      for (const slot_t &s : old_slots) {
+        if (s.offset == EMPTY || s.offset == DELETED) continue;
+
+        size_t i = home(s.hash);
+        while (slots[i].offset != EMPTY)
+          i = (i + 1) & mask;
+        slots[i] = {s.hash, arena.size()};
+        auto begin = old_arena.begin() + s.offset;
+        arena.insert(arena.end(), begin, begin + 1 + *begin);
+      }
+      deleted = garbage = 0;
+    }
+  };
+
+  using hashset_t = conditional_t<flat_storage, flat_set, node_set>;
+
+  // Tablica zapisana przez hash_save() i zmapowana tylko do odczytu przez
+  // hash_load(). Plik ma układ flat_set: nagłówek, sloty i arenę, w słowach
+  // 64-bitowych w kolejności bajtów maszyny, więc wyszukiwanie działa wprost
+  // na zmapowanych stronach, a procesy mapujące ten sam plik je współdzielą.
+  class mapped_set {
+  public:
+    struct header_t {
+      uint64_t magic;
+      uint64_t version;
+      // Wbudowana funkcja haszująca albo CUSTOM_HASH.
+      uint64_t builtin;
+      uint64_t slot_count;
+      uint64_t count;
+      uint64_t arena_size;
+    };
+
+    struct slot_t {
+      uint64_t hash;
+      uint64_t offset;
+    };
+
+    static uint64_t const MAGIC = 0x485341484a504e31ull;
+    static uint64_t const VERSION = 1;
+    static uint64_t const CUSTOM_HASH = -1;
+    static uint64_t const EMPTY = -1;
+
+    // Pierwszy slot dla hasza, jak flat_set::home().
+    static size_t home(uint64_t h, size_t slot_count) {
+      return (h * 0x9E3779B97F4A7C15ull) >> (64 - floor_log2(slot_count));
+    }
+
+    // Przejmuje mapowanie [base, base + length), które musi już być
+    // sprawdzone przez valid().
+    mapped_set(void *base, size_t length, custom_hash hash)
+        : base(base), length(length), hash(hash) {
+      header_t const *header = static_cast<header_t const *>(base);
+      slots = reinterpret_cast<slot_t const *>(header + 1);
+      arena = reinterpret_cast<uint64_t const *>(slots + header->slot_count);
+      slot_count = header->slot_count;
+      count = header->count;
+      arena_size = header->arena_size;
+    }
+
+    mapped_set(const mapped_set &) = delete;
+    mapped_set &operator=(const mapped_set &) = delete;
+
+    ~mapped_set() { munmap(base, length); }
+
+    // Sprawdza tylko nagłówek i długość pliku, więc nie czyta slotów ani
+    // areny i czas wczytania nie zależy od liczby ciągów. Sloty sprawdzają
+    // find() i for_each(), zanim przeczytają wskazany ciąg.
+    static bool valid(void const *base, size_t length) {
+      if (length < sizeof(header_t)) return false;
+      header_t const *header = static_cast<header_t const *>(base);
+      size_t words = (length - sizeof(header_t)) / sizeof(uint64_t);
+      return header->magic == MAGIC && header->version == VERSION &&
+             (length - sizeof(header_t)) % sizeof(uint64_t) == 0 &&
+             is_power_of_two(header->slot_count) &&
+             header->slot_count >= 2 && header->count < header->slot_count &&
+             header->slot_count <= words / 2 &&
+             header->arena_size == words - header->slot_count * 2;
+    }
+
+    size_t size() const { return count; }
+
+    bool empty() const { return count == 0; }
+
+    bool contains(key_view_t k) const { return find(k, hash(k)); }
+
+    template <typename K, typename R>
+    void contains_many(size_t n, K key, R result) const {
+      for (size_t i = 0; i < n; i++)
+        result(i, !key(i).empty() && contains(key(i)));
+    }
+
+    // Pomija sloty, których ciąg nie mieści się w arenie.
+    template <typename F>
+    void for_each(F f) const {
+      for (size_t i = 0; i < slot_count; i++) {
+        if (slots[i].offset != EMPTY && in_arena(slots[i].offset))
+          f(key_view_t(arena + slots[i].offset + 1, arena[slots[i].offset]));
+      }
+    }
+
+    size_t memory() const { return length; }
+
+    size_t bucket_count() const { return slot_count; }
+
+    custom_hash get_hash() const { return hash; }
+
+  private:
+    void *base;
+    size_t length;
+    custom_hash hash;
+    slot_t const *slots;
+    uint64_t const *arena;
+    size_t slot_count, count, arena_size;
+
+    // Czy ciąg spod offset razem z długością mieści się w arenie.
+    bool in_arena(uint64_t offset) const {
+      return offset < arena_size && arena[offset] < arena_size - offset;
+    }
+
+    // Próbkowanie kończy się najpóźniej po przejrzeniu wszystkich slotów,
+    // a położenia ciągów są sprawdzane, więc uszkodzony plik nie powoduje
+    // czytania poza mapowaniem.
+    bool find(key_view_t k, uint64_t h) const {
+      size_t i = home(h, slot_count);
+      for (size_t step = 0; step < slot_count && slots[i].offset != EMPTY;
+           step++, i = (i + 1) & (slot_count - 1)) {
+        const slot_t &s = slots[i];
+        if (s.hash == h && in_arena(s.offset) &&
+            arena[s.offset] == k.size() &&
+            equal(k.begin(), k.end(), arena + s.offset + 1))
+          return true;
+      }
+      return false;
     }
+  };
+
+  // Blokowy filtr Blooma: wszystkie bity ciągu leżą w jednym bloku
+  // wielkości linii pamięci podręcznej, więc sprawdzenie to jeden odczyt
+  // z pamięci. Ciągi są haszowane wbudowaną wymix_hash(), niezależnie od
+  // funkcji tablicy, która przy odpowiedzi "nie ma" nie jest wcale wołana.
+  class bloom_filter {
+  public:
+    explicit bloom_filter(size_t capacity) { reset(capacity); }
+
+    bool may_contain(key_view_t k) const {
+      uint64_t h = wymix_hash(k);
+      const block_t &block = blocks[block_index(h)];
+      uint64_t bits = mum(h, PRIME[2]);
+      for (size_t i = 0; i < BITS_PER_KEY; i++, bits >>= 9) {
+        size_t bit = bits & 511;
+        if (!(block.words[bit / 64] >> (bit % 64) & 1)) return false;
+      }
+      return true;
+    }
+
+    void add(key_view_t k) {
+      uint64_t h = wymix_hash(k);
+      block_t &block = blocks[block_index(h)];
+      uint64_t bits = mum(h, PRIME[2]);
+      for (size_t i = 0; i < BITS_PER_KEY; i++, bits >>= 9) {
+        size_t bit = bits & 511;
+        block.words[bit / 64] |= uint64_t(1) << (bit % 64);
+      }
+    }
+
+    // Zeruje filtr i ustawia jego rozmiar na capacity ciągów.
+    void reset(size_t capacity) {
+      this->capacity = std::max(capacity, size_t(KEYS_PER_BLOCK));
+      blocks.assign((this->capacity + KEYS_PER_BLOCK - 1) / KEYS_PER_BLOCK,
+                    block_t{});
+    }
+
+    // Liczba ciągów, dla której filtr ma zakładany odsetek fałszywie
+    // dodatnich odpowiedzi (około 0,1%).
+    size_t get_capacity() const { return capacity; }
 
-    explicit custom_hash(hash_function_t hf) : hash_function(hf) {}
+    size_t memory() const { return blocks.capacity() * sizeof(block_t); }
+
+  private:
+    struct alignas(64) block_t {
+      uint64_t words[8];
+    };
+
+    // 16 bitów filtra na ciąg i 6 ustawianych bitów na ciąg.
+    static size_t const KEYS_PER_BLOCK = 32;
+    static size_t const BITS_PER_KEY = 6;
+
+    vector<block_t> blocks;
+    size_t capacity;
+
+    size_t block_index(uint64_t h) const {
+      return (unsigned __int128) h * blocks.size() >> 64;
+    }
   };
 
-  using hashset_t = unordered_set<key_t, custom_hash>;
-  using hashsets_t = unordered_map<id_t, hashset_t>;
+  // Wątki wykonujące operacje na tablicach, jak w RCU. Operacja zapisuje
+  // w rekordzie swojego wątku epokę, w której się zaczęła, i dopiero potem
+  // szuka tablicy w rejestrze, bez żadnej wspólnej blokady. Usuwana
+  // tablica najpierw znika z rejestru, potem epoka rośnie, a tablica jest
+  // niszczona dopiero wtedy, gdy żaden wątek nie jest w operacji
+  // rozpoczętej wcześniej. Rekordy nie są zwalniane: po zakończeniu wątku
+  // przejmuje je następny.
+  class readers_t {
+  public:
+    struct alignas(64) reader_t {
+      // Epoka trwającej operacji albo 0 poza operacją.
+      atomic<uint64_t> epoch{0};
+      atomic<bool> owned{true};
+      // Zagłębienie operacji, gdy funkcja haszująca woła inną operację.
+      // Zmienia je tylko właściciel rekordu.
+      size_t depth = 0;
+      // Kolejny numer rekordu; wybiera pasek blokady tablicy.
+      size_t index;
+      reader_t *next;
+    };
+
+    // Rekord bieżącego wątku.
+    reader_t &current() {
+      thread_local handle_t handle(*this);
+      return *handle.reader;
+    }
+
+    void enter(reader_t &r) {
+      if (r.depth++ == 0) r.epoch.store(epoch.load(), memory_order_seq_cst);
+    }
+
+    void leave(reader_t &r) {
+      if (--r.depth == 0) r.epoch.store(0, memory_order_release);
+    }
+
+    // Czeka, aż skończą się operacje innych wątków rozpoczęte przed
+    // wywołaniem.
+    void synchronize() {
+      uint64_t now = epoch.fetch_add(1) + 1;
+      reader_t const *self = &current();
+      for (reader_t *r = head.load(memory_order_acquire); r; r = r->next) {
+        if (r == self) continue;
+        for (uint64_t e = r->epoch.load(); e != 0 && e < now;
+             e = r->epoch.load())
+          std::this_thread::yield();
+      }
+    }
+
+  private:
+    // Przejmuje wolny rekord albo dopisuje nowy na początek listy.
+    struct handle_t {
+      reader_t *reader = nullptr;
+
+      explicit handle_t(readers_t &readers) {
+        for (reader_t *r = readers.head.load(memory_order_acquire); r;
+             r = r->next) {
+          bool owned = false;
+          if (!r->owned.load(memory_order_relaxed) &&
+              r->owned.compare_exchange_strong(owned, true)) {
+            reader = r;
+            return;
+          }
+        }
+        reader = new reader_t;
+        reader->index = readers.count.fetch_add(1, memory_order_relaxed);
+        reader->next = readers.head.load(memory_order_relaxed);
+        while (!readers.head.compare_exchange_weak(reader->next, reader,
+                                                   memory_order_release))
+          ;
+      }
+
+      ~handle_t() { reader->owned.store(false, memory_order_release); }
+    };
+
+    atomic<uint64_t> epoch{1};
+    atomic<reader_t *> head{nullptr};
+    atomic<size_t> count{0};
+  };
+
+  namespace {
+    readers_t &get_readers() {
+      static readers_t readers;
+      return readers;
+    }
+  }
+
+  // Czas jednej operacji na tablicach: od utworzenia do zniszczenia obiektu
+  // tablica znaleziona w rejestrze nie zostanie zniszczona.
+  class reading_t {
+  public:
+    reading_t() : reader(get_readers().current()) {
+      get_readers().enter(reader);
+    }
+
+    ~reading_t() { get_readers().leave(reader); }
+
+    reading_t(const reading_t &) = delete;
+    reading_t &operator=(const reading_t &) = delete;
+
+  private:
+    readers_t::reader_t &reader;
+  };
+
+  // Blokada czytelników i pisarzy rozłożona na STRIPES liczników.
+  // Czytelnik zwiększa tylko licznik paska swojego wątku, więc czytelnicy
+  // tej samej tablicy nie przerzucają między rdzeniami jednej linii
+  // pamięci. Pisarz bierze writers, ustawia writer i czeka, aż liczniki
+  // wszystkich pasków spadną do zera; czytelnik, który zobaczy writer,
+  // wycofuje się i czeka na writers. Zapis writer i odczyty liczników
+  // (tak jak u czytelnika zapis licznika i odczyt writer) są seq_cst, bo
+  // przy słabszym porządku pisarz i czytelnik mogliby nie zobaczyć
+  // nawzajem swoich zapisów i oba weszliby do tablicy.
+  class striped_mutex {
+  public:
+    void lock_shared() {
+      atomic<size_t> &readers = stripes[stripe()].readers;
+      for (;;) {
+        readers.fetch_add(1, memory_order_seq_cst);
+        if (!writer.load(memory_order_seq_cst)) return;
+        readers.fetch_sub(1, memory_order_release);
+        lock_guard wait(writers);
+      }
+    }
+
+    void unlock_shared() {
+      stripes[stripe()].readers.fetch_sub(1, memory_order_release);
+    }
+
+    void lock() {
+      writers.lock();
+      writer.store(true, memory_order_seq_cst);
+      for (const stripe_t &s : stripes)
+        while (s.readers.load(memory_order_seq_cst) != 0)
+          std::this_thread::yield();
+    }
+
+    void unlock() {
+      writer.store(false, memory_order_release);
+      writers.unlock();
+    }
+
+    static size_t const STRIPES = 8;
+
+    // Pasek bieżącego wątku.
+    static size_t stripe() {
+      return get_readers().current().index % STRIPES;
+    }
+
+  private:
+    struct alignas(64) stripe_t {
+      atomic<size_t> readers{0};
+    };
+
+    stripe_t stripes[STRIPES];
+    alignas(64) atomic<bool> writer{false};
+    std::mutex writers;
+  };
+
+  // Tablica razem z blokadą: operacje tylko czytające (hash_test,
+  // hash_size) biorą ją współdzieloną, więc mogą działać równolegle.
+  // Opcjonalny filtr Blooma jest przebudowywany, gdy ciągów jest więcej,
+  // niż go zaplanowano, albo gdy od ostatniej przebudowy usunięto ich tyle,
+  // że wiele bitów jest już nieaktualnych.
+  // Tablica wczytana przez hash_load() ma tylko mapped i nie da się jej
+  // zmieniać.
+  struct table_t {
+    hashset_t set;
+    custom_hash hash;
+    unique_ptr<mapped_set> mapped;
+    optional<bloom_filter> filter;
+    mutable striped_mutex mutex;
+    // Identyfikator nadany przez rejestr przed opublikowaniem tablicy.
+    id_t id = 0;
+    // Statystyki filtra: sprawdzenia, odpowiedzi "nie ma" i odpowiedzi
+    // "może jest" dla ciągów, których nie było. Każdy pasek blokady ma
+    // swoje liczniki, więc wątki sprawdzające tę samą tablicę nie
+    // zwiększają wspólnych; filter_stats() je sumuje.
+    struct alignas(64) filter_counts_t {
+      atomic<size_t> tests{0}, negatives{0}, false_positives{0};
+    };
+    unique_ptr<filter_counts_t[]> filter_counts;
+    // Liczba ciągów usuniętych od ostatniej przebudowy filtra.
+    size_t removed = 0;
+
+    table_t(size_t bucket_count, custom_hash hash)
+        : set(bucket_count, hash), hash(hash) {}
+
+    void add_filter(size_t capacity) {
+      filter.emplace(capacity);
+      filter_counts = make_unique<filter_counts_t[]>(striped_mutex::STRIPES);
+    }
+
+    void filter_stats(hash_filter_stats_t &stats) const {
+      stats = {filter->memory(), 0, 0, 0};
+      for (size_t i = 0; i < striped_mutex::STRIPES; i++) {
+        const filter_counts_t &counts = filter_counts[i];
+        stats.tests += counts.tests.load(memory_order_relaxed);
+        stats.negatives += counts.negatives.load(memory_order_relaxed);
+        stats.false_positives +=
+            counts.false_positives.load(memory_order_relaxed);
+      }
+    }
+
+    bool read_only() const { return mapped != nullptr; }
+
+    size_t size() const { return mapped ? mapped->size() : set.size(); }
+
+    bool empty() const { return size() == 0; }
+
+    size_t bucket_count() const {
+      return mapped ? mapped->bucket_count() : set.bucket_count();
+    }
+
+    size_t rehash_count() const { return mapped ? 0 : set.rehash_count(); }
+
+    // Zbiór ciągów (albo cały zmapowany plik) razem z filtrem.
+    size_t memory() const {
+      if (mapped) return mapped->memory();
+      return set.memory() + (filter ? filter->memory() : 0);
+    }
+
+    bool insert(key_view_t k) {
+      if (!set.insert(k)) return false;
+      if (filter) {
+        if (set.size() > filter->get_capacity())
+          rebuild_filter();
+        else
+          filter->add(k);
+      }
+      return true;
+    }
+
+    bool erase(key_view_t k) {
+      if (!set.erase(k)) return false;
+      if (filter && ++removed > filter->get_capacity() / 2)
+        rebuild_filter();
+      return true;
+    }
+
+    bool contains(key_view_t k) const {
+      if (mapped) return mapped->contains(k);
+      if (!filter) return set.contains(k);
+
+      filter_counts_t &counts = filter_counts[striped_mutex::stripe()];
+      counts.tests.fetch_add(1, memory_order_relaxed);
+      if (!filter->may_contain(k)) {
+        counts.negatives.fetch_add(1, memory_order_relaxed);
+        return false;
+      }
+      bool found = set.contains(k);
+      if (!found) counts.false_positives.fetch_add(1, memory_order_relaxed);
+      return found;
+    }
+
+    // Z filtrem każdy ciąg najpierw sprawdza filtr, więc ciągi nie są
+    // haszowane grupami.
+    template <typename K, typename R>
+    void contains_many(size_t n, K key, R result) const {
+      if (mapped) return mapped->contains_many(n, key, result);
+      if (!filter) return set.contains_many(n, key, result);
+      for (size_t i = 0; i < n; i++)
+        result(i, !key(i).empty() && contains(key(i)));
+    }
+
+    // Filtr też jest od razu powiększany do n ciągów.
+    void reserve(size_t n) {
+      set.reserve(n);
+      if (filter && n > filter->get_capacity()) rebuild_filter(n);
+    }
+
+    void clear() {
+      set.clear();
+      if (filter) filter->reset(filter->get_capacity());
+      removed = 0;
+    }
+
+    template <typename F>
+    void for_each(F f) const {
+      if (mapped)
+        mapped->for_each(f);
+      else
+        set.for_each(f);
+    }
+
+    void rebuild_filter(size_t capacity = 0) {
+      filter->reset(std::max({filter->get_capacity(), set.size() * 2,
+                              capacity}));
+      set.for_each([this](key_view_t k) { filter->add(k); });
+      removed = 0;
+    }
+  };
 
   int const INITIAL_SIZE = 16;
 
+  int const SLOT_BITS = std::numeric_limits<id_t>::digits / 2;
+  id_t const SLOT_MASK = (id_t(1) << SLOT_BITS) - 1;
+  // Miejsce w ostatnim pokoleniu nie jest już oddawane do ponownego użycia.
+  id_t const LAST_GENERATION = id_t(-1) >> SLOT_BITS;
+
+  // Identyfikator, którego nie ma żadna tablica, bo miejsce SLOT_MASK nigdy
+  // nie jest zajmowane. Dawany zamiast identyfikatora nowej tablicy, gdy
+  // zajęte są wszystkie miejsca albo nie podano funkcji haszującej.
+  id_t const INVALID_ID = -1;
+
+  // Tablice według miejsc. Identyfikator tablicy to numer jej miejsca
+  // (młodsze SLOT_BITS bitów) i pokolenie tego miejsca (starsze bity).
+  // Usunięcie tablicy zwiększa pokolenie miejsca i oddaje je do ponownego
+  // użycia, więc identyfikator usuniętej tablicy nie pasuje do następnej.
+  // Miejsca leżą w kawałkach, z których c-ty ma 2^c miejsc, a kawałki się
+  // nie przesuwają, więc find() nie bierze blokady; mutex chroni tylko
+  // tworzenie i usuwanie tablic.
+  class registry_t {
+  public:
+    registry_t() {
+      for (atomic<slot_t *> &chunk : chunks)
+        chunk.store(nullptr, memory_order_relaxed);
+    }
+
+    registry_t(const registry_t &) = delete;
+    registry_t &operator=(const registry_t &) = delete;
+
+    ~registry_t() {
+      for (size_t i = 0; i < slot_count; i++)
+        delete slot(i).table.load(memory_order_relaxed);
+      for (atomic<slot_t *> &chunk : chunks)
+        delete[] chunk.load(memory_order_relaxed);
+    }
+
+    // Tablica o identyfikatorze id albo nullptr. Wołający musi trzymać
+    // reading_t, dopóki używa tablicy.
+    table_t *find(id_t id) const {
+      size_t i = id & SLOT_MASK;
+      if (i == SLOT_MASK) return nullptr;
+      slot_t const *chunk = chunks[chunk_of(i)].load(memory_order_acquire);
+      if (!chunk) return nullptr;
+      table_t *table =
+          chunk[i - first_of(chunk_of(i))].table.load(memory_order_seq_cst);
+      return table && table->id == id ? table : nullptr;
+    }
+
+    // Daje INVALID_ID, gdy zajęte są wszystkie miejsca.
+    id_t add(unique_ptr<table_t> table) {
+      lock_guard lock(mutex);
+      size_t i;
+      if (!free_slots.empty()) {
+        i = free_slots.back();
+        free_slots.pop_back();
+      } else if (slot_count < SLOT_MASK) {
+        i = slot_count++;
+        atomic<slot_t *> &chunk = chunks[chunk_of(i)];
+        if (!chunk.load(memory_order_relaxed))
+          chunk.store(new slot_t[size_t(1) << chunk_of(i)],
+                      memory_order_release);
+      } else {
+        return INVALID_ID;
+      }
+
+      slot_t &s = slot(i);
+      id_t id = table->id = s.generation << SLOT_BITS | i;
+      s.table.store(table.release(), memory_order_seq_cst);
+      return id;
+    }
+
+    // Wyjmuje tablicę z rejestru i niszczy ją, gdy skończą się operacje,
+    // które mogły ją znaleźć.
+    bool remove(id_t id) {
+      table_t *table;
+      {
+        lock_guard lock(mutex);
+        if (!(table = find(id))) return false;
+        slot_t &s = slot(id & SLOT_MASK);
+        s.table.store(nullptr, memory_order_seq_cst);
+        if (s.generation < LAST_GENERATION) {
+          s.generation++;
+          free_slots.push_back(id & SLOT_MASK);
+        }
+      }
+      get_readers().synchronize();
+      delete table;
+      return true;
+    }
+
+  private:
+    struct slot_t {
+      atomic<table_t *> table{nullptr};
+      id_t generation = 0;
+    };
+
+    std::mutex mutex;
+    atomic<slot_t *> chunks[SLOT_BITS];
+    size_t slot_count = 0;
+    vector<size_t> free_slots;
+
+    static size_t chunk_of(size_t i) { return floor_log2(i + 1); }
+
+    static size_t first_of(size_t chunk) { return (size_t(1) << chunk) - 1; }
+
+    slot_t &slot(size_t i) const {
+      return chunks[chunk_of(i)].load(memory_order_relaxed)
+          [i - first_of(chunk_of(i))];
+    }
+  };
+
   namespace {
-    hashsets_t &get_hashsets() {
-      static hashsets_t hashsets;
-      return hashsets;
+    registry_t &get_registry() {
+      static registry_t registry;
+      return registry;
     }
 
     string seq_rep(uint64_t const *seq, size_t size) {
@@ -50,40 +1043,40 @@ namespace jnp1 {
       return res;
     }
 
-    string seq_rep(key_t &v) {
+    string seq_rep(key_view_t v) {
       return seq_rep(v.data(), v.size());
     }
 
-    bool check_table_exists(const string &func_name, unsigned long id) {
-      if (!get_hashsets().count(id)) {
+    void cerr_no_table(const string &func_name, unsigned long id) {
+      cerr << func_name << ": hash table #" << id << " does not exist"
+           << endl;
+    }
+
+    table_t *find_table(const string &func_name, unsigned long id) {
+      table_t *table = get_registry().find(id);
+      if (!table && debug) cerr_no_table(func_name, id);
+      return table;
+    }
+
+    // Jak find_table(), ale tablica wczytana przez hash_load() też się nie
+    // nadaje.
+    table_t *find_writable_table(const string &func_name, unsigned long id) {
+      table_t *table = find_table(func_name, id);
+      if (table && table->read_only()) {
         if (debug)
-          cerr << func_name << ": hash table #" << id << " does not exist"
+          cerr << func_name << ": hash table #" << id << " is read-only"
                << endl;
-        return false;
+        return nullptr;
       }
-      return true;
+      return table;
     }
 
-    void cerr_seq_state(const string &func_name, unsigned long id, key_t &v,
-                        const string &state) {
+    void cerr_seq_state(const string &func_name, unsigned long id,
+                        key_view_t v, const string &state) {
       cerr << func_name << ": hash table #" << id
            << ", sequence " << seq_rep(v) << " " << state << endl;
     }
 
-    bool
-    assert_not_present(const string &func_name, unsigned long id, key_t &v) {
-      if (get_hashsets().at(id).count(v) == 0) return true;
-      if (debug) cerr_seq_state(func_name, id, v, "was present");
-      return false;
-    }
-
-    bool
-    assert_is_present(const string &func_name, unsigned long id, key_t &v) {
-      if (get_hashsets().at(id).count(v) > 0) return true;
-      if (debug) cerr_seq_state(func_name, id, v, "was not present");
-      return false;
-    }
-
     bool
     check_args (const string &func_name, uint64_t const *seq, size_t size) {
       bool passed = true;
@@ -104,94 +1097,633 @@ namespace jnp1 {
       return passed;
     }
 
+    // Sprawdza wskaźnik name, przez który funkcja oddaje wynik albo
+    // dostaje nazwę pliku.
+    bool check_pointer(const string &func_name, void const *pointer,
+                       char const *name) {
+      if (!pointer) {
+        if (debug)
+          cerr << func_name << ": invalid pointer (" << name << ")" << endl;
+        return false;
+      }
+      return true;
+    }
+
+    // Wbudowaną funkcję wybiera się przez hash_create_builtin(), więc
+    // pusta funkcja użytkownika jest błędem.
+    bool check_hash_function(const string &func_name,
+                             hash_function_t hash_function) {
+      if (!hash_function) {
+        if (debug)
+          cerr << func_name << ": invalid hash function (NULL)" << endl;
+        return false;
+      }
+      return true;
+    }
+
+    bool known_builtin(hash_builtin_t builtin) {
+      return builtin == HASH_BUILTIN_WYMIX || builtin == HASH_BUILTIN_LANES;
+    }
+
+    // hash_builtin_t przychodzi także z C, więc może mieć dowolną wartość.
+    bool check_builtin(const string &func_name, hash_builtin_t builtin) {
+      if (!known_builtin(builtin)) {
+        if (debug)
+          cerr << func_name << ": invalid builtin hash function (" << builtin
+               << ")" << endl;
+        return false;
+      }
+      return true;
+    }
+
     void print_fun_call(const string &func_name, unsigned long id, uint64_t
     const *seq, size_t size) {
       if (debug)
         cerr << func_name << "(" << id << ", " << seq_rep(seq, size) <<
              ", " << size << ")" << endl;
     }
+
+    void print_many_call(const string &func_name, unsigned long id,
+                         size_t count) {
+      if (debug)
+        cerr << func_name << "(" << id << ", " << count << " sequence(s))"
+             << endl;
+    }
+
+    bool check_many_args(const string &func_name, uint64_t const *data,
+                         size_t const *offsets, size_t count) {
+      if (count > 0 && (!data || !offsets)) {
+        if (debug)
+          cerr << func_name << ": invalid pointer (" << (data ? "" : "data")
+               << (data || offsets ? "" : ", ") << (offsets ? "" : "offsets")
+               << ")" << endl;
+        return false;
+      }
+      return true;
+    }
+
+    id_t add_table(const string &func_name, unique_ptr<table_t> table,
+                   const string &state) {
+      id_t id = get_registry().add(std::move(table));
+      if (id == INVALID_ID) {
+        if (debug) cerr << func_name << ": too many hash tables" << endl;
+        return INVALID_ID;
+      }
+
+      if (debug)
+        cerr << func_name << ": hash table #" << id << " " << state << endl;
+
+      return id;
+    }
+
+    // Tablica od razu mieści capacity ciągów. Jeśli filter_capacity nie
+    // jest puste, tablica dostaje filtr Blooma na tyle ciągów.
+    id_t create_table(const string &func_name, custom_hash hash,
+                      size_t capacity = 0,
+                      optional<size_t> filter_capacity = {}) {
+      auto table = make_unique<table_t>(INITIAL_SIZE, hash);
+      if (filter_capacity) table->add_filter(*filter_capacity);
+      if (capacity) table->reserve(capacity);
+      return add_table(func_name, std::move(table), "created");
+    }
+
+    // Zawartość pliku zapisywanego przez hash_save(), bez slotów
+    // usuniętych ciągów i z co najmniej ćwiercią slotów wolnych.
+    struct image_t {
+      mapped_set::header_t header;
+      vector<mapped_set::slot_t> slots;
+      vector<uint64_t> arena;
+    };
+
+    image_t build_image(const table_t &table) {
+      // Ciągi liczy for_each(), a nie size(): w uszkodzonym pliku z
+      // hash_load() liczba w nagłówku może się różnić od liczby ciągów.
+      size_t count = 0;
+      table.for_each([&](key_view_t) { count++; });
+      size_t slot_count =
+          std::max<size_t>(2, ceil_power_of_two(count + count / 3 + 1));
+      image_t image;
+      image.slots.assign(slot_count, {0, mapped_set::EMPTY});
+
+      table.for_each([&](key_view_t k) {
+        uint64_t h = table.hash(k);
+        size_t i = mapped_set::home(h, slot_count);
+        while (image.slots[i].offset != mapped_set::EMPTY)
+          i = (i + 1) & (slot_count - 1);
+        image.slots[i] = {h, image.arena.size()};
+        image.arena.push_back(k.size());
+        image.arena.insert(image.arena.end(), k.begin(), k.end());
+      });
+
+      image.header = {
+        mapped_set::MAGIC, mapped_set::VERSION,
+        table.hash.is_builtin ? uint64_t(table.hash.builtin)
+                              : mapped_set::CUSTOM_HASH,
+        slot_count, count, image.arena.size()
+      };
+      return image;
+    }
+
+    // Plik powstaje pod nazwą tymczasową i dopiero potem zastępuje path,
+    // więc tablice zmapowane z poprzedniej wersji pliku się nie zmieniają.
+    bool write_image(const image_t &image, const string &path) {
+      string tmp = path + ".tmp";
+      FILE *file = fopen(tmp.c_str(), "wb");
+      if (!file) return false;
+
+      bool written =
+          fwrite(&image.header, sizeof(image.header), 1, file) == 1 &&
+          fwrite(image.slots.data(), sizeof(mapped_set::slot_t),
+                 image.slots.size(), file) == image.slots.size() &&
+          fwrite(image.arena.data(), sizeof(uint64_t), image.arena.size(),
+                 file) == image.arena.size();
+      if (fclose(file) != 0) written = false;
+
+      if (written && rename(tmp.c_str(), path.c_str()) == 0) return true;
+      remove(tmp.c_str());
+      return false;
+    }
+
+    // Mapuje plik path i sprawdza jego nagłówek. Daje nullptr, jeśli się
+    // nie udało albo plik nie pasuje do funkcji haszującej hash_function.
+    unique_ptr<mapped_set> map_image(const string &func_name,
+                                     char const *path,
+                                     hash_function_t hash_function) {
+      int fd = open(path, O_RDONLY);
+      if (fd < 0) {
+        if (debug) cerr << func_name << ": cannot open " << path << endl;
+        return nullptr;
+      }
+
+      struct stat st{};
+      void *base = MAP_FAILED;
+      if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(uint64_t))
+        base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      close(fd);
+
+      size_t length = st.st_size;
+      if (base == MAP_FAILED || !mapped_set::valid(base, length)) {
+        if (base != MAP_FAILED) munmap(base, length);
+        if (debug) cerr << func_name << ": invalid file " << path << endl;
+        return nullptr;
+      }
+
+      uint64_t builtin = static_cast<mapped_set::header_t *>(base)->builtin;
+      if (builtin == mapped_set::CUSTOM_HASH ? !hash_function
+                                             : hash_function ||
+                                               builtin > HASH_BUILTIN_LANES) {
+        munmap(base, length);
+        if (debug)
+          cerr << func_name << ": hash function does not match " << path
+               << endl;
+        return nullptr;
+      }
+
+      // Zapytania trafiają w losowe strony, więc czytanie z wyprzedzeniem
+      // tylko by przeszkadzało.
+      madvise(base, length, MADV_RANDOM);
+      custom_hash hash = hash_function ? custom_hash(hash_function)
+                                       : custom_hash(hash_builtin_t(builtin));
+      return make_unique<mapped_set>(base, length, hash);
+    }
+
+    // Ciąg numer i z bufora operacji na wielu ciągach.
+    key_view_t many_key(uint64_t const *data, size_t const *offsets,
+                        size_t i) {
+      size_t size = offsets[i + 1] > offsets[i] ? offsets[i + 1] - offsets[i]
+                                                : 0;
+      return key_view_t(data + offsets[i], size);
+    }
+
+    void clear_results(uint64_t *results, size_t count) {
+      if (results) std::fill(results, results + (count + 63) / 64, 0);
+    }
+
+    void set_result(uint64_t *results, size_t i) {
+      if (results) results[i / 64] |= uint64_t(1) << (i % 64);
+    }
+
+    void print_many_done(const string &func_name, unsigned long id,
+                         size_t done, size_t count, const string &state) {
+      if (debug)
+        cerr << func_name << ": hash table #" << id << ", " << done
+             << " of " << count << " sequence(s) " << state << endl;
+    }
+
+    // Wspólna część hash_insert_many() i hash_remove_many(): op(tablica,
+    // ciąg) wykonuje operację i daje jej wynik, a success i failure opisują
+    // go w informacjach diagnostycznych. Jeśli grow jest true, tablica jest
+    // najpierw powiększana na wszystkie ciągi naraz.
+    template <typename Op>
+    size_t modify_many(const string &func_name, unsigned long id,
+                       uint64_t const *data, size_t const *offsets,
+                       size_t count, uint64_t *results, bool grow, Op op,
+                       const string &success, const string &failure) {
+      print_many_call(func_name, id, count);
+      clear_results(results, count);
+
+      if (!check_many_args(func_name, data, offsets, count)) return 0;
+      reading_t reading;
+      table_t *table = find_writable_table(func_name, id);
+      if (!table) return 0;
+
+      unique_lock table_lock(table->mutex);
+      if (grow) table->reserve(table->size() + count);
+      size_t done = 0;
+      for (size_t i = 0; i < count; i++) {
+        key_view_t v = many_key(data, offsets, i);
+        if (!check_args(func_name, v.data(), v.size())) continue;
+
+        if (op(*table, v)) {
+          if (debug) cerr_seq_state(func_name, id, v, success);
+          set_result(results, i);
+          done++;
+        } else if (debug) {
+          cerr_seq_state(func_name, id, v, failure);
+        }
+      }
+
+      print_many_done(func_name, id, done, count, success);
+      return done;
+    }
+
+    // Śledzenie wywołań włączane w czasie działania przez hash_set_trace(),
+    // także w wersji skompilowanej z -DNDEBUG. Wywołanie tylko wkłada
+    // rekord do kolejki, a formatowaniem i wypisywaniem na cerr zajmuje się
+    // osobny wątek. Gdy kolejka jest pełna, rekord jest pomijany i liczony.
+    enum trace_op_t : uint8_t {
+      Create, CreateBuiltin, CreateFiltered, CreateWithCapacity, Delete,
+      Size, Insert, Remove, Clear, Test, FilterStats, Save, Load, Reserve,
+      Stats, InsertMany, RemoveMany, TestMany
+    };
+
+    char const *const TRACE_NAMES[] = {
+      "hash_create", "hash_create_builtin", "hash_create_filtered",
+      "hash_create_with_capacity", "hash_delete", "hash_size", "hash_insert",
+      "hash_remove", "hash_clear", "hash_test", "hash_filter_stats",
+      "hash_save", "hash_load", "hash_reserve", "hash_stats",
+      "hash_insert_many", "hash_remove_many", "hash_test_many"
+    };
+
+    // Liczba zapamiętywanych początkowych wyrazów ciągu.
+    size_t const TRACE_WORDS = 4;
+    size_t const TRACE_CAPACITY = 1 << 16;
+
+    struct trace_record_t {
+      trace_op_t op;
+      bool has_seq;
+      id_t id;
+      // Długość ciągu albo liczba ciągów w operacji na wielu ciągach.
+      size_t size;
+      // Wynik: wartość logiczna, identyfikator albo liczba.
+      size_t result;
+      uint64_t words[TRACE_WORDS];
+    };
+
+    // Ograniczona kolejka wielu producentów i wielu konsumentów bez blokad
+    // (D. Vyukov): komórka ma licznik mówiący, czy jest wolna dla push() czy
+    // zajęta dla pop() na danej pozycji.
+    class trace_queue_t {
+    public:
+      explicit trace_queue_t(size_t capacity)
+          : cells(make_unique<cell_t[]>(capacity)), mask(capacity - 1) {
+        for (size_t i = 0; i < capacity; i++)
+          cells[i].sequence.store(i, memory_order_relaxed);
+      }
+
+      bool push(const trace_record_t &record) {
+        size_t pos = enqueue_pos.load(memory_order_relaxed);
+        for (;;) {
+          cell_t &cell = cells[pos & mask];
+          size_t sequence = cell.sequence.load(memory_order_acquire);
+          if (sequence == pos) {
+            if (enqueue_pos.compare_exchange_weak(pos, pos + 1,
+                                                  memory_order_relaxed)) {
+              cell.record = record;
+              cell.sequence.store(pos + 1, memory_order_release);
+              return true;
+            }
+          } else if (sequence < pos) {
+            return false;
+          } else {
+            pos = enqueue_pos.load(memory_order_relaxed);
+          }
+        }
+      }
+
+      bool pop(trace_record_t &record) {
+        size_t pos = dequeue_pos.load(memory_order_relaxed);
+        for (;;) {
+          cell_t &cell = cells[pos & mask];
+          size_t sequence = cell.sequence.load(memory_order_acquire);
+          if (sequence == pos + 1) {
+            if (dequeue_pos.compare_exchange_weak(pos, pos + 1,
+                                                  memory_order_relaxed)) {
+              record = cell.record;
+              cell.sequence.store(pos + mask + 1, memory_order_release);
+              return true;
+            }
+          } else if (sequence < pos + 1) {
+            return false;
+          } else {
+            pos = dequeue_pos.load(memory_order_relaxed);
+          }
+        }
+      }
+
+    private:
+      struct cell_t {
+        atomic<size_t> sequence;
+        trace_record_t record;
+      };
+
+      unique_ptr<cell_t[]> cells;
+      size_t mask;
+      alignas(64) atomic<size_t> enqueue_pos{0};
+      alignas(64) atomic<size_t> dequeue_pos{0};
+    };
+
+    // Stała inicjalizacja, więc flaga jest gotowa przed jakimkolwiek
+    // wywołaniem, także z konstruktorów obiektów globalnych.
+    atomic<bool> tracing{false};
+
+    class trace_sink_t;
+    trace_sink_t &get_trace_sink();
+
+    class trace_sink_t {
+    public:
+      void start() {
+        std::lock_guard lock(control);
+        if (drainer.joinable()) return;
+        if (!queue) {
+          queue = make_unique<trace_queue_t>(TRACE_CAPACITY);
+          std::atexit([] { get_trace_sink().stop(); });
+        }
+        running.store(true, memory_order_relaxed);
+        drainer = std::thread(&trace_sink_t::drain, this);
+        tracing.store(true, memory_order_release);
+      }
+
+      void stop() {
+        std::lock_guard lock(control);
+        tracing.store(false, memory_order_relaxed);
+        if (!drainer.joinable()) return;
+        running.store(false, memory_order_relaxed);
+        drainer.join();
+      }
+
+      void push(const trace_record_t &record) {
+        if (!queue->push(record))
+          dropped.fetch_add(1, memory_order_relaxed);
+      }
+
+    private:
+      std::mutex control;
+      unique_ptr<trace_queue_t> queue;
+      std::thread drainer;
+      atomic<bool> running{false};
+      atomic<size_t> dropped{0};
+
+      // Wypisuje rekordy porcjami, jednym zapisem na porcję, a gdy kolejka
+      // jest pusta, czeka chwilę. Po stop() wypisuje jeszcze resztę.
+      void drain() {
+        trace_record_t record;
+        string out;
+        for (;;) {
+          bool stopping = !running.load(memory_order_relaxed);
+          while (out.size() < 1 << 16 && queue->pop(record))
+            format(record, out);
+          if (size_t lost = dropped.exchange(0, memory_order_relaxed))
+            out += "hash trace: " + to_string(lost) + " record(s) dropped\n";
+
+          if (!out.empty()) {
+            cerr << out;
+            out.clear();
+          } else if (stopping) {
+            return;
+          } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+          }
+        }
+      }
+
+      static void format(const trace_record_t &r, string &out) {
+        out += TRACE_NAMES[r.op];
+        out += "(";
+        if (r.op == CreateBuiltin || r.op == CreateFiltered ||
+            r.op == CreateWithCapacity)
+          out += to_string(r.size);
+        else if (r.op != Create && r.op != Load)
+          out += to_string(r.id);
+        if (r.op == Reserve) {
+          out += ", " + to_string(r.size);
+        } else if (r.op >= InsertMany) {
+          out += ", " + to_string(r.size) + " sequence(s)";
+        } else if (r.op == Insert || r.op == Remove || r.op == Test) {
+          out += ", ";
+          if (!r.has_seq) {
+            out += "NULL";
+          } else {
+            out += "\"";
+            for (size_t i = 0; i < r.size && i < TRACE_WORDS; i++) {
+              if (i > 0) out += " ";
+              out += to_string(r.words[i]);
+            }
+            if (r.size > TRACE_WORDS) out += " ...";
+            out += "\"";
+          }
+          out += ", " + to_string(r.size);
+        }
+        out += ")";
+
+        if (r.op == Insert || r.op == Remove || r.op == Test ||
+            r.op == FilterStats || r.op == Save || r.op == Load ||
+            r.op == Reserve || r.op == Stats)
+          out += r.result ? " = true" : " = false";
+        else if (r.op != Delete && r.op != Clear)
+          out += " = " + to_string(r.result);
+        out += "\n";
+      }
+    };
+
+    // Nigdy nieniszczony, bo funkcje modułu mogą być wołane z destruktorów
+    // obiektów globalnych także po zniszczeniu zmiennych statycznych tego
+    // pliku. Resztę rekordów wypisuje przy wyjściu stop() zarejestrowany
+    // przez start().
+    trace_sink_t &get_trace_sink() {
+      static trace_sink_t *const sink = new trace_sink_t;
+      return *sink;
+    }
+
+    // Rekord jednego wywołania, wkładany do kolejki przy wyjściu z funkcji,
+    // o ile śledzenie jest włączone. Wynik podaje się przez
+    // return trace(wynik).
+    class trace_call_t {
+    public:
+      trace_call_t(trace_op_t op, id_t id, uint64_t const *seq = nullptr,
+                   size_t size = 0)
+          : op(op), id(id), seq(seq), size(size) {}
+
+      ~trace_call_t() {
+        if (!tracing.load(memory_order_acquire)) return;
+
+        trace_record_t record{op, seq != nullptr, id, size, result, {}};
+        if (op == Insert || op == Remove || op == Test) {
+          for (size_t i = 0; seq && i < size && i < TRACE_WORDS; i++)
+            record.words[i] = seq[i];
+        }
+        get_trace_sink().push(record);
+      }
+
+      template <typename T>
+      T operator()(T value) {
+        result = value;
+        return value;
+      }
+
+    private:
+      trace_op_t op;
+      id_t id;
+      uint64_t const *seq;
+      size_t size;
+      size_t result = 0;
+    };
   }
 
   unsigned long hash_create(hash_function_t hash_function) {
+    trace_call_t trace(Create, 0);
     if (debug) cerr << __func__ << "(" << (void*) hash_function << ")" << endl;
-    hashset_t new_hashset(INITIAL_SIZE, custom_hash(hash_function));
+    if (!check_hash_function(__func__, hash_function))
+      return trace(INVALID_ID);
+    return trace(create_table(__func__, custom_hash(hash_function)));
+  }
+
+  unsigned long hash_create_builtin(hash_builtin_t builtin) {
+    trace_call_t trace(CreateBuiltin, 0, nullptr, builtin);
+    if (debug) cerr << __func__ << "(" << builtin << ")" << endl;
+    if (!check_builtin(__func__, builtin)) return trace(INVALID_ID);
+    return trace(create_table(__func__, custom_hash(builtin)));
+  }
 
-    static id_t last_id = 0;
-    get_hashsets().emplace(last_id, new_hashset);
+  uint64_t hash_builtin_value(hash_builtin_t builtin, uint64_t const *seq,
+                              size_t size) {
+    // Komunikaty są budowane tylko dla błędnych argumentów, żeby nie
+    // spowalniać samego haszowania.
+    if (!known_builtin(builtin) || !seq || !size) {
+      check_builtin(__func__, builtin);
+      check_args(__func__, seq, size);
+      return 0;
+    }
+    return custom_hash(builtin)(key_view_t(seq, size));
+  }
 
+  unsigned long hash_create_filtered(hash_function_t hash_function,
+                                     size_t expected) {
+    trace_call_t trace(CreateFiltered, 0, nullptr, expected);
     if (debug)
-      cerr << __func__ << ": hash table #" << last_id << " created"
-           << endl;
+      cerr << __func__ << "(" << (void*) hash_function << ", " << expected
+           << ")" << endl;
+    if (!check_hash_function(__func__, hash_function))
+      return trace(INVALID_ID);
+    return trace(create_table(__func__, custom_hash(hash_function), 0,
+                              expected));
+  }
 
-    return last_id++;
+  unsigned long hash_create_with_capacity(hash_function_t hash_function,
+                                          size_t capacity) {
+    trace_call_t trace(CreateWithCapacity, 0, nullptr, capacity);
+    if (debug)
+      cerr << __func__ << "(" << (void*) hash_function << ", " << capacity
+           << ")" << endl;
+    if (!check_hash_function(__func__, hash_function))
+      return trace(INVALID_ID);
+    return trace(create_table(__func__, custom_hash(hash_function),
+                              capacity));
   }
 
   bool hash_insert(unsigned long id, uint64_t const *seq, size_t size) {
+    trace_call_t trace(Insert, id, seq, size);
     print_fun_call(__func__, id, seq, size);
 
-    if (!check_args(__func__, seq, size)) return false;
-    if (!check_table_exists(__func__, id)) return false;
-
-    key_t v(size);
-    copy(seq, seq + size, v.begin());
+    if (!check_args(__func__, seq, size)) return trace(false);
+    reading_t reading;
+    table_t *table = find_writable_table(__func__, id);
+    if (!table) return trace(false);
 
-    if (!assert_not_present(__func__, id, v)) return false;
+    key_view_t v(seq, size);
 
-    if (get_hashsets().at(id).emplace(v).second) {
-      if (debug) cerr_seq_state(__func__, id, v, "inserted");
-      return true;
+    unique_lock table_lock(table->mutex);
+    if (!table->insert(v)) {
+      if (debug) cerr_seq_state(__func__, id, v, "was present");
+      return trace(false);
     }
-    return false;
+
+    if (debug) cerr_seq_state(__func__, id, v, "inserted");
+    return trace(true);
   }
 
   void hash_delete(unsigned long id) {
+    trace_call_t trace(Delete, id);
     if (debug) cerr << __func__ << "(" << id << ")" << endl;
 
-    if (check_table_exists(__func__, id)) {
-      get_hashsets().erase(id);
-      if (debug)
-        cerr << __func__
-             << ": hash table #" << id << " deleted" << endl;
+    if (!get_registry().remove(id)) {
+      if (debug) cerr_no_table(__func__, id);
+    } else if (debug) {
+      cerr << __func__
+           << ": hash table #" << id << " deleted" << endl;
     }
   }
 
   size_t hash_size(unsigned long id) {
+    trace_call_t trace(Size, id);
     if (debug) cerr << __func__ << "(" << id << ")" << endl;
-    if (!check_table_exists(__func__, id)) return 0;
+    reading_t reading;
+    table_t const *table = find_table(__func__, id);
+    if (!table) return trace(0);
 
-    size_t count = get_hashsets().at(id).size();
+    shared_lock table_lock(table->mutex);
+    size_t count = table->size();
 
     if (debug)
       cerr << __func__
            << ": hash table #" << id << " contains " << count << " element(s)"
            << endl;
 
-    return count;
+    return trace(count);
   }
 
   bool hash_remove(unsigned long id, uint64_t const *seq, std::size_t size) {
+    trace_call_t trace(Remove, id, seq, size);
     print_fun_call(__func__, id, seq, size);
 
-    if (!check_args(__func__, seq, size)) return false;
-    if (!check_table_exists(__func__, id)) return false;
+    if (!check_args(__func__, seq, size)) return trace(false);
+    reading_t reading;
+    table_t *table = find_writable_table(__func__, id);
+    if (!table) return trace(false);
 
-    key_t v(size);
-    copy(seq, seq + size, v.begin());
+    key_view_t v(seq, size);
 
-    if (assert_is_present(__func__, id, v)) {
-      if (debug) cerr_seq_state(__func__, id, v, "removed");
-      return get_hashsets().at(id).erase(v) == 1;
-    } else
-      return false;
+    unique_lock table_lock(table->mutex);
+    if (!table->erase(v)) {
+      if (debug) cerr_seq_state(__func__, id, v, "was not present");
+      return trace(false);
+    }
+
+    if (debug) cerr_seq_state(__func__, id, v, "removed");
+    return trace(true);
   }
 
   void hash_clear(unsigned long id) {
+    trace_call_t trace(Clear, id);
     if (debug) cerr << __func__ << "(" << id << ")" << endl;
-    if (!check_table_exists(__func__, id)) return;
+    reading_t reading;
+    table_t *table = find_writable_table(__func__, id);
+    if (!table) return;
 
+    unique_lock table_lock(table->mutex);
     bool empty;
-    if (!(empty = get_hashsets().at(id).empty()))
-      get_hashsets().at(id).clear();
+    if (!(empty = table->empty()))
+      table->clear();
 
     if (debug)
       cerr << __func__ << ": hash table #" << id
@@ -199,20 +1731,198 @@ namespace jnp1 {
   }
 
   bool hash_test(unsigned long id, uint64_t const *seq, std::size_t size) {
+    trace_call_t trace(Test, id, seq, size);
     print_fun_call(__func__, id, seq, size);
 
-    if (!check_args(__func__, seq, size)) return false;
-    if (!check_table_exists(__func__, id)) return false;
+    if (!check_args(__func__, seq, size)) return trace(false);
+    reading_t reading;
+    table_t const *table = find_table(__func__, id);
+    if (!table) return trace(false);
 
-    key_t v(size);
-    copy(seq, seq + size, v.begin());
+    key_view_t v(seq, size);
 
+    shared_lock table_lock(table->mutex);
     bool present;
 
-    present = get_hashsets().at(id).count(v);
+    present = table->contains(v);
     if (debug)
       cerr_seq_state(__func__, id, v,
                      present ? "is present" : "is not present");
-    return present;
+    return trace(present);
+  }
+
+  size_t hash_insert_many(unsigned long id, uint64_t const *data,
+                          size_t const *offsets, size_t count,
+                          uint64_t *results) {
+    trace_call_t trace(InsertMany, id, nullptr, count);
+    return trace(modify_many(__func__, id, data, offsets, count, results,
+                             true, [](table_t &table, key_view_t v) {
+                               return table.insert(v);
+                             }, "inserted", "was present"));
+  }
+
+  size_t hash_remove_many(unsigned long id, uint64_t const *data,
+                          size_t const *offsets, size_t count,
+                          uint64_t *results) {
+    trace_call_t trace(RemoveMany, id, nullptr, count);
+    return trace(modify_many(__func__, id, data, offsets, count, results,
+                             false, [](table_t &table, key_view_t v) {
+                               return table.erase(v);
+                             }, "removed", "was not present"));
+  }
+
+  size_t hash_test_many(unsigned long id, uint64_t const *data,
+                        size_t const *offsets, size_t count,
+                        uint64_t *results) {
+    trace_call_t trace(TestMany, id, nullptr, count);
+    print_many_call(__func__, id, count);
+    clear_results(results, count);
+
+    if (!check_many_args(__func__, data, offsets, count)) return trace(0);
+    reading_t reading;
+    table_t const *table = find_table(__func__, id);
+    if (!table) return trace(0);
+
+    shared_lock table_lock(table->mutex);
+    size_t present = 0;
+    string const func_name = __func__;
+    auto key = [=](size_t i) { return many_key(data, offsets, i); };
+    table->contains_many(count, key, [&](size_t i, bool found) {
+      key_view_t v = key(i);
+      if (!check_args(func_name, v.data(), v.size())) return;
+
+      if (debug)
+        cerr_seq_state(func_name, id, v,
+                       found ? "is present" : "is not present");
+      if (found) {
+        set_result(results, i);
+        present++;
+      }
+    });
+
+    print_many_done(__func__, id, present, count, "present");
+    return trace(present);
+  }
+
+  bool hash_filter_stats(unsigned long id, hash_filter_stats_t *stats) {
+    trace_call_t trace(FilterStats, id);
+    if (debug) cerr << __func__ << "(" << id << ")" << endl;
+    if (!check_pointer(__func__, stats, "stats")) return trace(false);
+    reading_t reading;
+    table_t const *table = find_table(__func__, id);
+    if (!table) return trace(false);
+
+    shared_lock table_lock(table->mutex);
+    if (!table->filter) {
+      if (debug)
+        cerr << __func__ << ": hash table #" << id << " has no filter"
+             << endl;
+      return trace(false);
+    }
+
+    table->filter_stats(*stats);
+
+    if (debug)
+      cerr << __func__ << ": hash table #" << id << " filter uses "
+           << stats->memory << " byte(s), " << stats->false_positives
+           << " false positive(s) in " << stats->tests << " test(s)" << endl;
+    return trace(true);
+  }
+
+  bool hash_reserve(unsigned long id, size_t capacity) {
+    trace_call_t trace(Reserve, id, nullptr, capacity);
+    if (debug) cerr << __func__ << "(" << id << ", " << capacity << ")" << endl;
+    reading_t reading;
+    table_t *table = find_writable_table(__func__, id);
+    if (!table) return trace(false);
+
+    unique_lock table_lock(table->mutex);
+    table->reserve(capacity);
+
+    if (debug)
+      cerr << __func__ << ": hash table #" << id << " has "
+           << table->bucket_count() << " bucket(s)" << endl;
+    return trace(true);
+  }
+
+  bool hash_stats(unsigned long id, hash_stats_t *stats) {
+    trace_call_t trace(Stats, id);
+    if (debug) cerr << __func__ << "(" << id << ")" << endl;
+    if (!check_pointer(__func__, stats, "stats")) return trace(false);
+    reading_t reading;
+    table_t const *table = find_table(__func__, id);
+    if (!table) return trace(false);
+
+    shared_lock table_lock(table->mutex);
+    stats->size = table->size();
+    stats->bucket_count = table->bucket_count();
+    stats->load_factor = double(stats->size) / stats->bucket_count;
+    stats->rehash_count = table->rehash_count();
+    stats->memory = table->memory();
+
+    if (debug)
+      cerr << __func__ << ": hash table #" << id << " contains "
+           << stats->size << " element(s) in " << stats->bucket_count
+           << " bucket(s), rehashed " << stats->rehash_count
+           << " time(s), uses " << stats->memory << " byte(s)" << endl;
+    return trace(true);
+  }
+
+  bool hash_save(unsigned long id, char const *path) {
+    trace_call_t trace(Save, id);
+    if (debug)
+      cerr << __func__ << "(" << id << ", " << (path ? path : "NULL") << ")"
+           << endl;
+    if (!check_pointer(__func__, path, "path")) return trace(false);
+
+    image_t image;
+    {
+      reading_t reading;
+      table_t const *table = find_table(__func__, id);
+      if (!table) return trace(false);
+
+      shared_lock table_lock(table->mutex);
+      image = build_image(*table);
+    }
+
+    if (!write_image(image, path)) {
+      if (debug) cerr << __func__ << ": cannot write " << path << endl;
+      return trace(false);
+    }
+
+    if (debug)
+      cerr << __func__ << ": hash table #" << id << " saved to " << path
+           << endl;
+    return trace(true);
+  }
+
+  bool hash_load(char const *path, hash_function_t hash_function,
+                 unsigned long *id) {
+    trace_call_t trace(Load, 0);
+    if (debug)
+      cerr << __func__ << "(" << (path ? path : "NULL") << ", "
+           << (void*) hash_function << ")" << endl;
+    if (!check_pointer(__func__, path, "path") ||
+        !check_pointer(__func__, id, "id"))
+      return trace(false);
+
+    unique_ptr<mapped_set> mapped = map_image(__func__, path, hash_function);
+    if (!mapped) return trace(false);
+
+    // Zbiór w tablicy tylko do odczytu nie jest używany.
+    auto table = make_unique<table_t>(0, mapped->get_hash());
+    table->mapped = std::move(mapped);
+    id_t new_id = add_table(__func__, std::move(table),
+                            string("loaded from ") + path);
+    if (new_id == INVALID_ID) return trace(false);
+    *id = new_id;
+    return trace(true);
+  }
+
+  void hash_set_trace(bool enabled) {
+    if (enabled)
+      get_trace_sink().start();
+    else
+      get_trace_sink().stop();
   }
-}
\ No newline at end of file
+}
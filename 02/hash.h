@@ -0,0 +1,178 @@
+#ifndef HASH_H
+#define HASH_H
+
+#ifdef __cplusplus
+#include <cstdint>
+#include <cstddef>
+
+namespace jnp1 {
+  extern "C" {
+#else
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#endif
+
+/* Funkcja haszująca ciąg liczb o podanej długości. */
+typedef uint64_t (*hash_function_t)(uint64_t const *, size_t);
+
+/* Tworzy tablicę haszującą i zwraca jej identyfikator. Jeśli hash_function
+ * jest NULL, nie tworzy tablicy i daje (unsigned long) -1, identyfikator,
+ * którego nie ma żadna tablica; wbudowaną funkcję haszującą wybiera się
+ * przez hash_create_builtin(). */
+unsigned long hash_create(hash_function_t hash_function);
+
+/* Wbudowane funkcje haszujące: HASH_BUILTIN_WYMIX jest najszybsza dla
+ * krótkich ciągów, HASH_BUILTIN_LANES dla długich (kilkunastu i więcej
+ * wyrazów). */
+typedef enum {
+  HASH_BUILTIN_WYMIX,
+  HASH_BUILTIN_LANES
+} hash_builtin_t;
+
+/* Tworzy tablicę haszującą z wbudowaną funkcją haszującą i zwraca jej
+ * identyfikator. Jeśli builtin nie jest jedną z HASH_BUILTIN_*, nie tworzy
+ * tablicy i daje (unsigned long) -1, jak hash_create(). */
+unsigned long hash_create_builtin(hash_builtin_t builtin);
+
+/* Daje wartość wbudowanej funkcji haszującej builtin dla ciągu seq
+ * o długości size, tę samą, której używają tablice z hash_create_builtin().
+ * Nie dotyczy żadnej tablicy, więc nie jest śledzona. Daje 0, jeśli builtin
+ * nie jest jedną z HASH_BUILTIN_*, seq jest NULL lub size jest 0. */
+uint64_t hash_builtin_value(hash_builtin_t builtin, uint64_t const *seq,
+                            size_t size);
+
+/* Tworzy tablicę haszującą z filtrem Blooma przed zbiorem ciągów i zwraca
+ * jej identyfikator. Filtr odpowiada na większość zapytań hash_test()
+ * o ciągi, których nie ma w tablicy, bez wołania funkcji haszującej
+ * i przeglądania tablicy, kosztem około 2 bajtów na ciąg. Parametr expected
+ * to spodziewana liczba ciągów; przy większej filtr jest przebudowywany.
+ * Pusta hash_function jak w hash_create(). */
+unsigned long hash_create_filtered(hash_function_t hash_function,
+                                   size_t expected);
+
+/* Statystyki filtra Blooma tablicy: zajmowana pamięć w bajtach, liczba
+ * sprawdzeń w filtrze, liczba odpowiedzi "nie ma" udzielonych przez sam
+ * filtr i liczba odpowiedzi "może jest" dla ciągów, których w tablicy nie
+ * było. Odsetek fałszywie dodatnich odpowiedzi wśród ciągów spoza tablicy
+ * to false_positives / (negatives + false_positives). */
+typedef struct {
+  size_t memory;
+  size_t tests;
+  size_t negatives;
+  size_t false_positives;
+} hash_filter_stats_t;
+
+/* Tworzy tablicę haszującą, która od razu mieści capacity ciągów bez
+ * przebudowywania, i zwraca jej identyfikator. Pusta hash_function jak
+ * w hash_create(). */
+unsigned long hash_create_with_capacity(hash_function_t hash_function,
+                                        size_t capacity);
+
+/* Powiększa tablicę haszującą o identyfikatorze id tak, żeby mieściła
+ * capacity ciągów bez przebudowywania. Nigdy jej nie zmniejsza. Daje false,
+ * jeśli nie ma takiej tablicy lub została ona wczytana przez hash_load(). */
+bool hash_reserve(unsigned long id, size_t capacity);
+
+/* Statystyki tablicy: liczba ciągów, liczba kubełków (slotów), średnia
+ * liczba ciągów na kubełek, liczba przebudowań niepustej tablicy, w tym
+ * przez hash_reserve(), i przybliżona liczba zajmowanych bajtów, razem
+ * z filtrem Blooma; dla tablicy z hash_load() jest to długość pliku. */
+typedef struct {
+  size_t size;
+  size_t bucket_count;
+  double load_factor;
+  size_t rehash_count;
+  size_t memory;
+} hash_stats_t;
+
+/* Wypełnia *stats statystykami tablicy haszującej o identyfikatorze id.
+ * Daje false, jeśli nie ma takiej tablicy lub stats jest NULL. */
+bool hash_stats(unsigned long id, hash_stats_t *stats);
+
+/* Usuwa tablicę haszującą o identyfikatorze id, o ile ona istnieje. Później
+ * utworzone tablice mogą zająć jej miejsce, ale nie jej identyfikator, więc
+ * id nie wskazuje już żadnej tablicy. */
+void hash_delete(unsigned long id);
+
+/* Daje liczbę ciągów w tablicy haszującej o identyfikatorze id lub 0, jeśli
+ * taka tablica nie istnieje. */
+size_t hash_size(unsigned long id);
+
+/* Wstawia ciąg seq o długości size do tablicy haszującej o identyfikatorze
+ * id. Daje false, jeśli nie ma takiej tablicy, zawiera ona już taki ciąg,
+ * seq jest NULL lub size jest 0. */
+bool hash_insert(unsigned long id, uint64_t const *seq, size_t size);
+
+/* Usuwa ciąg seq o długości size z tablicy haszującej o identyfikatorze id.
+ * Daje false, jeśli nie ma takiej tablicy, nie zawiera ona takiego ciągu,
+ * seq jest NULL lub size jest 0. */
+bool hash_remove(unsigned long id, uint64_t const *seq, size_t size);
+
+/* Usuwa wszystkie ciągi z tablicy haszującej o identyfikatorze id, o ile
+ * ona istnieje. */
+void hash_clear(unsigned long id);
+
+/* Daje true, jeśli tablica haszująca o identyfikatorze id istnieje
+ * i zawiera ciąg seq o długości size. */
+bool hash_test(unsigned long id, uint64_t const *seq, size_t size);
+
+/* Wypełnia *stats statystykami filtra Blooma tablicy haszującej
+ * o identyfikatorze id. Daje false, jeśli nie ma takiej tablicy, nie ma
+ * ona filtra lub stats jest NULL. */
+bool hash_filter_stats(unsigned long id, hash_filter_stats_t *stats);
+
+/* Zapisuje tablicę haszującą o identyfikatorze id do pliku path w układzie,
+ * który hash_load() mapuje do pamięci bez przepisywania. Plik jest zależny
+ * od kolejności bajtów maszyny. Daje false, jeśli nie ma takiej tablicy,
+ * path jest NULL lub zapis się nie powiódł. */
+bool hash_save(unsigned long id, char const *path);
+
+/* Mapuje do pamięci tylko do odczytu tablicę zapisaną przez hash_save()
+ * i zapisuje jej identyfikator w *id. Czas nie zależy od liczby ciągów,
+ * a procesy wczytujące ten sam plik współdzielą jego strony. hash_function
+ * musi być tą samą funkcją, z którą tablicę zapisano, albo NULL, jeśli
+ * tablica miała wbudowaną funkcję haszującą. hash_test(), hash_size()
+ * i hash_save() działają na takiej tablicy jak zwykle, a hash_insert(),
+ * hash_remove() i hash_clear() jej nie zmieniają. Pliku nie wolno zmieniać,
+ * dopóki tablica istnieje; hash_save() zastępuje plik nowym, więc tego
+ * warunku nie łamie. Daje false, jeśli pliku nie da się odczytać, nie jest
+ * to tablica zapisana przez hash_save(), funkcja haszująca nie pasuje lub
+ * path albo id jest NULL. Uszkodzenia slotów pliku nie są wykrywane przy
+ * wczytaniu; hash_test() i hash_save() pomijają takie sloty. */
+bool hash_load(char const *path, hash_function_t hash_function,
+               unsigned long *id);
+
+/* Operacje na wielu ciągach naraz. Ciąg numer i (0 <= i < count) to
+ * data[offsets[i]], ..., data[offsets[i + 1] - 1], więc tablica offsets ma
+ * count + 1 elementów. Ciąg pusty (offsets[i + 1] <= offsets[i]) jest
+ * niepoprawny. Jeśli results nie jest NULL, to musi mieć miejsce na
+ * (count + 63) / 64 liczb; bit i % 64 liczby results[i / 64] mówi, czy
+ * operacja na ciągu numer i się powiodła, tak jak wynik odpowiedniej
+ * operacji na pojedynczym ciągu. Wynikiem jest liczba udanych operacji.
+ * hash_insert_many() najpierw powiększa tablicę na wszystkie count ciągów,
+ * więc jest przebudowywana co najwyżej raz. */
+size_t hash_insert_many(unsigned long id, uint64_t const *data,
+                        size_t const *offsets, size_t count,
+                        uint64_t *results);
+size_t hash_remove_many(unsigned long id, uint64_t const *data,
+                        size_t const *offsets, size_t count,
+                        uint64_t *results);
+size_t hash_test_many(unsigned long id, uint64_t const *data,
+                      size_t const *offsets, size_t count,
+                      uint64_t *results);
+
+/* Włącza lub wyłącza śledzenie wywołań funkcji modułu, działające także
+ * po skompilowaniu z -DNDEBUG. Wywołania są zapisywane do kolejki
+ * i wypisywane na standardowy strumień błędów przez osobny wątek, więc
+ * prawie nie spowalniają samych funkcji. Z ciągów zapisywane są tylko
+ * pierwsze wyrazy. Jeśli kolejka jest pełna, wywołanie nie jest zapisywane,
+ * a liczba takich wywołań jest wypisywana. */
+void hash_set_trace(bool enabled);
+
+#ifdef __cplusplus
+  }
+}
+#endif
+
+#endif /* HASH_H */
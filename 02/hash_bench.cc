@@ -0,0 +1,263 @@
+// Skalowanie operacji modułu hash z liczbą wątków. Wszystkie wątki
+// pracują na jednej tablicy z n ciągami {2k, 2k + 1}: sprawdzają losowe
+// ciągi, z których połowy nie ma, a w -w procentach operacji wstawiają
+// i usuwają własny ciąg. Dla 1, 2, 4, ... wątków wypisuje łączną liczbę
+// operacji na sekundę i średni czas operacji w wątku. Przy dobrym
+// skalowaniu same sprawdzenia (-w 0) rosną liniowo aż do liczby rdzeni.
+//
+//   g++ -Wall -Wextra -O2 -std=c++17 -DNDEBUG -c hash.cc -o hash.o
+//   g++ -O2 -std=c++17 hash_bench.cc hash.o -o hash_bench -pthread
+//   ./hash_bench [-t WĄTKI] [-n CIĄGI] [-o OPERACJE] [-w PROCENT] [-b]
+//   ./hash_bench -q
+//
+// -t to największa liczba wątków (domyślnie liczba rdzeni), -o liczba
+// operacji na wątek, a -b wybiera wbudowaną funkcję haszującą zamiast
+// funkcji użytkownika.
+//
+// Przed pomiarem skalowania wypisuje pamięć tablicy na ciąg i średni czas
+// hash_test() w jednym wątku. Układ tablicy wybiera się przy kompilowaniu
+// hash.cc, więc oba układy porównuje się, budując hash.o także
+// z -DHASH_FLAT.
+//
+// -q porównuje same funkcje haszujące: naiwną h = h * 31 + x, funkcję
+// użytkownika z tego pliku i obie wbudowane. Dla ciągów 2, 8, 64 i 1024
+// słów wypisuje przepustowość haszowania danych z pamięci podręcznej,
+// a dla 2^20 ciągów {i, j, 0}, i, j < 1024, chi-kwadrat na kubełek
+// młodszych 16 bitów hasza (około 1 dla równomiernego rozkładu) i liczbę
+// pełnych 64-bitowych kolizji.
+
+#include "hash.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using std::size_t, std::vector;
+
+namespace {
+  using clock_type = std::chrono::steady_clock;
+
+  struct options_t {
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t keys = 1000000;
+    size_t ops = 2000000;
+    size_t write_percent = 0;
+    bool builtin = false;
+    bool quality = false;
+  };
+
+  uint64_t seq_hash(uint64_t const *seq, size_t size) {
+    uint64_t h = size;
+    for (size_t i = 0; i < size; i++)
+      h = (h ^ seq[i]) * 0x9E3779B97F4A7C15ull;
+    return h ^ h >> 29;
+  }
+
+  uint64_t naive_hash(uint64_t const *seq, size_t size) {
+    uint64_t h = 0;
+    for (size_t i = 0; i < size; i++)
+      h = h * 31 + seq[i];
+    return h;
+  }
+
+  uint64_t wymix_hash(uint64_t const *seq, size_t size) {
+    return jnp1::hash_builtin_value(jnp1::HASH_BUILTIN_WYMIX, seq, size);
+  }
+
+  uint64_t lanes_hash(uint64_t const *seq, size_t size) {
+    return jnp1::hash_builtin_value(jnp1::HASH_BUILTIN_LANES, seq, size);
+  }
+
+  struct named_hash_t {
+    char const *name;
+    jnp1::hash_function_t hash;
+  };
+
+  named_hash_t const HASHES[] = {{"naive", naive_hash},
+                                 {"user", seq_hash},
+                                 {"wymix", wymix_hash},
+                                 {"lanes", lanes_hash}};
+
+  size_t const WORDS[] = {2, 8, 64, 1024};
+
+  // Wynik haszowania, żeby kompilator go nie pominął.
+  uint64_t volatile sink;
+
+  // Haszuje 256 MB danych ciągami po words słów z bufora 256 KB, który
+  // mieści się w pamięci podręcznej, i daje przepustowość w GB/s.
+  double throughput(jnp1::hash_function_t hash, size_t words) {
+    vector<uint64_t> data(std::max<size_t>(words, 1 << 15));
+    uint64_t x = 1;
+    for (uint64_t &word : data)
+      word = x = x * 6364136223846793005ull + 1442695040888963407ull;
+
+    size_t const count = data.size() / words;
+    size_t const total = (size_t(1) << 25) / words;
+    uint64_t h = 0;
+    clock_type::time_point start = clock_type::now();
+    for (size_t i = 0; i < total; i++)
+      h ^= hash(data.data() + i % count * words, words);
+    std::chrono::duration<double> time = clock_type::now() - start;
+    sink = h;
+    return double(total) * words * sizeof(uint64_t) / time.count() / 1e9;
+  }
+
+  struct quality_t {
+    double chi2;
+    size_t collisions;
+  };
+
+  // Rozkład haszy ciągów {i, j, 0}: małe, regularne liczby, na których
+  // słabe funkcje dają skupione młodsze bity i kolizje.
+  quality_t quality(jnp1::hash_function_t hash) {
+    size_t const SIDE = 1024, BUCKETS = 1 << 16;
+    vector<uint64_t> hashes;
+    vector<size_t> buckets(BUCKETS);
+    hashes.reserve(SIDE * SIDE);
+    for (uint64_t i = 0; i < SIDE; i++) {
+      for (uint64_t j = 0; j < SIDE; j++) {
+        uint64_t seq[] = {i, j, 0};
+        hashes.push_back(hash(seq, 3));
+        buckets[hashes.back() & (BUCKETS - 1)]++;
+      }
+    }
+
+    double expected = double(hashes.size()) / BUCKETS, chi2 = 0;
+    for (size_t count : buckets)
+      chi2 += (count - expected) * (count - expected) / expected;
+
+    std::sort(hashes.begin(), hashes.end());
+    size_t collisions = 0;
+    for (size_t i = 1; i < hashes.size(); i++)
+      collisions += hashes[i] == hashes[i - 1];
+    return {chi2 / BUCKETS, collisions};
+  }
+
+  void compare_hashes() {
+    printf("%8s", "hash");
+    for (size_t words : WORDS)
+      printf(" %6zu w GB/s", words);
+    printf(" %12s %12s\n", "chi2/bucket", "collisions");
+
+    for (const named_hash_t &h : HASHES) {
+      printf("%8s", h.name);
+      for (size_t words : WORDS)
+        printf(" %13.2f", throughput(h.hash, words));
+      quality_t q = quality(h.hash);
+      printf(" %12.2f %12zu\n", q.chi2, q.collisions);
+    }
+  }
+
+  // Wykonuje ops operacji i daje liczbę znalezionych ciągów, żeby
+  // kompilator nie pominął sprawdzeń.
+  size_t work(unsigned long id, const options_t &options, uint64_t worker) {
+    uint64_t x = worker + 1;
+    size_t found = 0;
+    for (size_t i = 0; i < options.ops; i++) {
+      x = x * 6364136223846793005ull + 1442695040888963407ull;
+      uint64_t k = (x >> 33) % (options.keys * 2);
+      if ((x >> 16) % 100 < options.write_percent) {
+        // Ciągi {k, worker, 1} są tylko tego wątku.
+        uint64_t seq[] = {k, worker, 1};
+        jnp1::hash_insert(id, seq, 3);
+        jnp1::hash_remove(id, seq, 3);
+      } else {
+        uint64_t seq[] = {k, k + 1};
+        found += jnp1::hash_test(id, seq, 2);
+      }
+    }
+    return found;
+  }
+
+  // Wypisuje pamięć tablicy na ciąg i średni czas hash_test() w jednym
+  // wątku, na tych samych ciągach co pomiar skalowania.
+  void report_layout(unsigned long id, const options_t &options) {
+    jnp1::hash_stats_t stats;
+    if (!jnp1::hash_stats(id, &stats)) return;
+
+    options_t reads = options;
+    reads.write_percent = 0;
+    clock_type::time_point start = clock_type::now();
+    work(id, reads, 0);
+    std::chrono::duration<double> time = clock_type::now() - start;
+
+    printf("%zu keys, %.1f B/key, %.1f ns/lookup\n\n", stats.size,
+           double(stats.memory) / stats.size,
+           time.count() * 1e9 / options.ops);
+  }
+
+  bool parse_options(int argc, char *argv[], options_t &options) {
+    for (int i = 1; i < argc; i++) {
+      if (!strcmp(argv[i], "-b")) {
+        options.builtin = true;
+        continue;
+      }
+      if (!strcmp(argv[i], "-q")) {
+        options.quality = true;
+        continue;
+      }
+      if (i + 1 == argc) return false;
+
+      size_t *value = !strcmp(argv[i], "-t")   ? &options.threads
+                      : !strcmp(argv[i], "-n") ? &options.keys
+                      : !strcmp(argv[i], "-o") ? &options.ops
+                      : !strcmp(argv[i], "-w") ? &options.write_percent
+                                               : nullptr;
+      if (!value) return false;
+      try {
+        *value = std::stoul(argv[++i]);
+      } catch (const std::exception &) {
+        return false;
+      }
+    }
+    return options.threads > 0 && options.keys > 0 &&
+           options.write_percent <= 100;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  options_t options;
+  if (!parse_options(argc, argv, options)) {
+    fprintf(stderr, "Usage: %s [-t THREADS] [-n KEYS] [-o OPS] [-w PERCENT]"
+                    " [-b]\n       %s -q\n", argv[0], argv[0]);
+    return 1;
+  }
+
+  if (options.quality) {
+    compare_hashes();
+    return 0;
+  }
+
+  unsigned long id = options.builtin
+                         ? jnp1::hash_create_builtin(jnp1::HASH_BUILTIN_WYMIX)
+                         : jnp1::hash_create(seq_hash);
+  jnp1::hash_reserve(id, options.keys);
+  for (uint64_t k = 0; k < options.keys * 2; k += 2) {
+    uint64_t seq[] = {k, k + 1};
+    jnp1::hash_insert(id, seq, 2);
+  }
+  report_layout(id, options);
+
+  printf("%8s %12s %12s\n", "threads", "Mops/s", "ns/op");
+  for (size_t threads = 1; threads <= options.threads; threads *= 2) {
+    vector<std::thread> workers;
+    vector<size_t> found(threads);
+    clock_type::time_point start = clock_type::now();
+    for (size_t w = 0; w < threads; w++)
+      workers.emplace_back([&, w] { found[w] = work(id, options, w); });
+    for (std::thread &t : workers)
+      t.join();
+    std::chrono::duration<double> time = clock_type::now() - start;
+
+    double ops = double(options.ops) * threads;
+    printf("%8zu %12.2f %12.1f\n", threads, ops / time.count() / 1e6,
+           time.count() * 1e9 / options.ops);
+  }
+
+  jnp1::hash_delete(id);
+  return 0;
+}
@@ -0,0 +1,176 @@
+// Test współbieżności modułu hash. Jednocześnie działają wątki, które:
+// - wstawiają, sprawdzają i usuwają własne ciągi we wspólnej tablicy,
+// - sprawdzają ciągi wstawione przed startem do wspólnej tablicy i do
+//   tablicy z filtrem Blooma,
+// - tworzą i usuwają tablice, w tym takie, które inne wątki właśnie czytają,
+//   i sprawdzają, że identyfikator usuniętej tablicy nie wskazuje nowej.
+// Na końcu sprawdza liczby ciągów i statystyki filtra.
+//
+// Kompilowanie i uruchomienie (-DNDEBUG, bo informacje diagnostyczne
+// zagłuszyłyby wynik):
+//
+//   g++ -Wall -Wextra -O2 -std=c++17 -DNDEBUG -c hash.cc -o hash.o
+//   g++ -O2 -std=c++17 hash_stress.cc hash.o -o hash_stress -pthread
+//   ./hash_stress [WĄTKI [POWTÓRZENIA]]
+
+#include "hash.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using std::atomic, std::size_t, std::vector;
+
+namespace {
+  uint64_t seq_hash(uint64_t const *seq, size_t size) {
+    uint64_t h = size;
+    for (size_t i = 0; i < size; i++)
+      h = (h ^ seq[i]) * 0x9E3779B97F4A7C15ull;
+    return h ^ h >> 29;
+  }
+
+  // Liczba zaobserwowanych błędów; test kończy się porażką, jeśli nie jest
+  // zerem.
+  atomic<size_t> failures{0};
+
+  void expect(bool condition, char const *what) {
+    if (!condition && failures.fetch_add(1) < 10)
+      fprintf(stderr, "hash_stress: %s\n", what);
+  }
+
+  // Ciągi {worker, i, 7}: każdy wątek ma swoje, więc wynik każdej operacji
+  // jest przewidywalny mimo innych wątków. Co drugi ciąg zostaje w tablicy.
+  void writer(unsigned long id, uint64_t worker, size_t rounds) {
+    for (uint64_t i = 0; i < rounds; i++) {
+      uint64_t seq[] = {worker, i, 7};
+      expect(jnp1::hash_insert(id, seq, 3), "insert of a new sequence");
+      expect(!jnp1::hash_insert(id, seq, 3), "insert of a present sequence");
+      expect(jnp1::hash_test(id, seq, 3), "test of an inserted sequence");
+      if (i % 2 == 1)
+        expect(jnp1::hash_remove(id, seq, 3), "remove of a present sequence");
+    }
+  }
+
+  // Sprawdza ciągi {2k, 2k + 1} wstawione przed startem, także grupami.
+  void reader(unsigned long id, size_t keys, uint64_t seed, size_t rounds) {
+    uint64_t x = seed;
+    for (size_t i = 0; i < rounds; i++) {
+      x = x * 6364136223846793005ull + 1442695040888963407ull;
+      uint64_t k = (x >> 33) % (keys * 2);
+      uint64_t seq[] = {k & ~1ull, (k & ~1ull) + 1};
+      // Ciągów {nieparzyste, ...} nie ma w tablicy.
+      uint64_t missing[] = {k | 1, k};
+      expect(jnp1::hash_test(id, seq, 2), "test of a preloaded sequence");
+      expect(!jnp1::hash_test(id, missing, 2), "test of a missing sequence");
+
+      if (i % 64 == 0) {
+        uint64_t data[] = {seq[0], seq[1], missing[0], missing[1]};
+        size_t offsets[] = {0, 2, 4};
+        uint64_t results = 0;
+        expect(jnp1::hash_test_many(id, data, offsets, 2, &results) == 1 &&
+                   results == 1,
+               "batch test of a present and a missing sequence");
+      }
+    }
+  }
+
+  // Tablice, które inne wątki czytają, podczas gdy ten wątek je usuwa
+  // i tworzy nowe. Tablica o identyfikatorze id zawiera tylko ciąg {id}.
+  struct churn_t {
+    static size_t const TABLES = 8;
+    atomic<unsigned long> ids[TABLES];
+    atomic<bool> done{false};
+  };
+
+  unsigned long create_marked() {
+    unsigned long id = jnp1::hash_create(seq_hash);
+    uint64_t mark = id;
+    expect(jnp1::hash_insert(id, &mark, 1), "insert into a new table");
+    return id;
+  }
+
+  void churner(churn_t &churn, size_t rounds) {
+    for (size_t i = 0; i < rounds; i++) {
+      size_t t = i % churn_t::TABLES;
+      unsigned long old_id = churn.ids[t].load();
+      jnp1::hash_delete(old_id);
+      // Nowa tablica zwykle zajmuje miejsce właśnie usuniętej, więc stary
+      // identyfikator, który by ją wskazał, dałby rozmiar 1.
+      churn.ids[t] = create_marked();
+
+      uint64_t mark = old_id;
+      expect(!jnp1::hash_test(old_id, &mark, 1), "test in a deleted table");
+      expect(jnp1::hash_size(old_id) == 0, "size of a deleted table");
+      expect(!jnp1::hash_insert(old_id, &mark, 1),
+             "insert into a deleted table");
+    }
+    churn.done = true;
+  }
+
+  void churn_reader(churn_t &churn) {
+    for (size_t i = 0; !churn.done; i++) {
+      unsigned long id = churn.ids[i % churn_t::TABLES].load();
+      uint64_t mark = id, other = id ^ 1;
+      // Tablica mogła właśnie zostać usunięta, więc o {id} nie wiadomo nic.
+      jnp1::hash_test(id, &mark, 1);
+      expect(!jnp1::hash_test(id, &other, 1), "test in a churned table");
+      expect(jnp1::hash_size(id) <= 1, "size of a churned table");
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  size_t threads = argc > 1 ? std::stoul(argv[1]) : 4;
+  size_t rounds = argc > 2 ? std::stoul(argv[2]) : 50000;
+  size_t const KEYS = 100000;
+
+  unsigned long shared = jnp1::hash_create(seq_hash);
+  unsigned long filtered = jnp1::hash_create_filtered(seq_hash, KEYS);
+  for (uint64_t k = 0; k < KEYS * 2; k += 2) {
+    uint64_t seq[] = {k, k + 1};
+    jnp1::hash_insert(shared, seq, 2);
+    jnp1::hash_insert(filtered, seq, 2);
+  }
+
+  churn_t churn;
+  for (atomic<unsigned long> &id : churn.ids)
+    id = create_marked();
+
+  vector<std::thread> workers;
+  for (size_t w = 0; w < threads; w++) {
+    workers.emplace_back(writer, shared, w, rounds);
+    workers.emplace_back(reader, shared, KEYS, w + 1, rounds);
+    workers.emplace_back(reader, filtered, KEYS, w + 101, rounds);
+    workers.emplace_back(churn_reader, std::ref(churn));
+  }
+  workers.emplace_back(churner, std::ref(churn), rounds / 10);
+  for (std::thread &t : workers)
+    t.join();
+
+  expect(jnp1::hash_size(shared) == KEYS + threads * (rounds / 2),
+         "final size of the shared table");
+
+  // Każde wywołanie reader() sprawdza w filtrze dwa ciągi na krok i dwa
+  // na każde hash_test_many(), i każde sprawdzenie ciągu spoza tablicy
+  // kończy się odpowiedzią filtra albo fałszywie dodatnią.
+  jnp1::hash_filter_stats_t stats;
+  size_t tests = threads * (rounds * 2 + (rounds + 63) / 64 * 2);
+  expect(jnp1::hash_filter_stats(filtered, &stats) && stats.tests == tests &&
+             stats.negatives + stats.false_positives == tests / 2,
+         "filter statistics");
+
+  for (atomic<unsigned long> &id : churn.ids)
+    jnp1::hash_delete(id);
+  jnp1::hash_delete(filtered);
+  jnp1::hash_delete(shared);
+
+  if (failures > 0) {
+    printf("FAILED: %zu error(s)\n", failures.load());
+    return 1;
+  }
+  printf("OK\n");
+  return 0;
+}